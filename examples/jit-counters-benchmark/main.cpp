@@ -0,0 +1,169 @@
+// Measures the overhead of -jit-counters and -jit-cycle-counters.
+//
+// The same kernel is JIT'd without instrumentation, with call counters, and with cycle counters, and each is timed
+// calling a small function many times. Small functions that are called often are where the overhead is largest, so
+// this is close to a worst case.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+// The kernel. scale is called once per element, and is kept out of line so each call is counted.
+static const char kKernelSource[] =
+    "__attribute__((noinline)) static float scale(float value, float factor)\n"
+    "{\n"
+    "    return value * factor + 1.0f;\n"
+    "}\n"
+    "\n"
+    "float sumScaled(const float* values, int count, float factor)\n"
+    "{\n"
+    "    float sum = 0.0f;\n"
+    "    for (int i = 0; i < count; ++i)\n"
+    "    {\n"
+    "        sum += scale(values[i], factor);\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n";
+
+typedef float(*SumScaledFunc)(const float* values, int count, float factor);
+
+struct Variant
+{
+    const char* name;
+    const char* arg;                ///< The slang-llvm argument, or nullptr for none
+};
+
+static SlangResult _compile(IDownstreamCompiler* compiler, const char* arg, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(UnownedStringSlice(kKernelSource)));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice(arg ? arg : "") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.optimizationLevel = DownstreamCompileOptions::OptimizationLevel::Default;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, arg ? 1 : 0);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+static double _timeCalls(SumScaledFunc func, const float* values, int count, int iterationCount)
+{
+    volatile float sink = 0.0f;
+
+    // Warm up, so the first touch of the code and data isn't timed
+    sink = sink + func(values, count, 0.5f);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterationCount; ++i)
+    {
+        sink = sink + func(values, count, 0.5f);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, const char* const* argv)
+{
+    // The number of times the kernel is run, each run calls scale elementCount times
+    int iterationCount = 20000;
+    if (argc > 1)
+    {
+        iterationCount = atoi(argv[1]);
+    }
+    const int elementCount = 1024;
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    float values[elementCount];
+    for (int i = 0; i < elementCount; ++i)
+    {
+        values[i] = float(i % 17);
+    }
+
+    const Variant variants[] =
+    {
+        { "uninstrumented", nullptr },
+        { "-jit-counters", "-jit-counters" },
+        { "-jit-cycle-counters", "-jit-cycle-counters" },
+    };
+
+    const double callCount = double(iterationCount) * (elementCount + 1);
+
+    double baseSeconds = 0.0;
+    for (const auto& variant : variants)
+    {
+        ComPtr<ISlangSharedLibrary> library;
+        if (SLANG_FAILED(_compile(compiler, variant.arg, library)))
+        {
+            fprintf(stderr, "Compilation failed for %s\n", variant.name);
+            return 1;
+        }
+
+        auto func = (SumScaledFunc)library->findFuncByName("sumScaled");
+        if (!func)
+        {
+            fprintf(stderr, "Unable to find the kernel for %s\n", variant.name);
+            return 1;
+        }
+
+        const double seconds = _timeCalls(func, values, elementCount, iterationCount);
+        if (!variant.arg)
+        {
+            baseSeconds = seconds;
+        }
+
+        printf("%-20s %8.3f s %8.2f ns/call %+8.1f%%\n", variant.name, seconds, seconds * 1e9 / callCount, (seconds / baseSeconds - 1.0) * 100.0);
+
+        // The counts include the warm up call
+        auto counters = variant.arg ? (ISlangLLVMJITCounters*)library->castAs(ISlangLLVMJITCounters::getTypeGuid()) : nullptr;
+        if (counters)
+        {
+            SlangLLVMFunctionCounters kernelCounters;
+            if (SLANG_SUCCEEDED(counters->findFunctionCounters("sumScaled", &kernelCounters)))
+            {
+                printf("%-20s %llu calls, %llu cycles\n", "", (unsigned long long)kernelCounters.callCount, (unsigned long long)kernelCounters.cycleCount);
+            }
+        }
+    }
+
+    return 0;
+}
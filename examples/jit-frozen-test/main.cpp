@@ -0,0 +1,240 @@
+// Test that looking up symbols of a frozen artifact (-jit-frozen) gives the same results as looking them up in the JIT.
+//
+// The same kernel is compiled with and without -jit-frozen. Checks that both export the same symbols, that individual
+// and bulk lookups find (and don't find) the same symbols, and that the functions and data found behave the same.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+// All the functions whose names start with "func" take and return an int
+static const char kKernelSource[] =
+    "static int helper(int value)\n"
+    "{\n"
+    "    return value * 3 + 1;\n"
+    "}\n"
+    "\n"
+    "const int table[4] = { 7, 11, 13, 17 };\n"
+    "int counter = 100;\n"
+    "\n"
+    "int funcAdd(int value) { return value + 1; }\n"
+    "int funcHelper(int value) { return helper(value) ^ 5; }\n"
+    "int funcTable(int value) { return table[value & 3] * value; }\n"
+    "int funcCounter(int value) { counter += value; return counter; }\n"
+    "int funcRecurse(int value) { return value <= 1 ? 1 : value * funcRecurse(value - 1); }\n";
+
+typedef int(*IntFunc)(int value);
+
+static SlangResult _compile(IDownstreamCompiler* compiler, const char* arg, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(UnownedStringSlice(kKernelSource)));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice(arg ? arg : "") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.optimizationLevel = DownstreamCompileOptions::OptimizationLevel::Default;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, arg ? 1 : 0);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+static std::vector<std::string> _getExportedNames(ISlangLLVMJITSharedLibrary* library)
+{
+    std::vector<std::string> names;
+    const size_t count = library->getExportedSymbolCount();
+    for (size_t i = 0; i < count; ++i)
+    {
+        names.push_back(library->getExportedSymbolName(i));
+    }
+    return names;
+}
+
+int main(int argc, const char* const* argv)
+{
+    SLANG_UNUSED(argc);
+    SLANG_UNUSED(argv);
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    ComPtr<ISlangSharedLibrary> jitLibrary;
+    ComPtr<ISlangSharedLibrary> frozenLibrary;
+    if (SLANG_FAILED(_compile(compiler, nullptr, jitLibrary)) ||
+        SLANG_FAILED(_compile(compiler, "-jit-frozen", frozenLibrary)))
+    {
+        fprintf(stderr, "Compilation failed\n");
+        return 1;
+    }
+
+    auto jit = (ISlangLLVMJITSharedLibrary*)jitLibrary->castAs(ISlangLLVMJITSharedLibrary::getTypeGuid());
+    auto frozen = (ISlangLLVMJITSharedLibrary*)frozenLibrary->castAs(ISlangLLVMJITSharedLibrary::getTypeGuid());
+    if (!jit || !frozen)
+    {
+        fprintf(stderr, "The libraries aren't JIT'd libraries\n");
+        return 1;
+    }
+
+    int failureCount = 0;
+
+    // Both export the same symbols
+    const std::vector<std::string> names = _getExportedNames(jit);
+    if (names != _getExportedNames(frozen))
+    {
+        fprintf(stderr, "The exported symbols differ\n");
+        failureCount++;
+    }
+    for (const char* expectedName : { "table", "counter", "funcAdd", "funcHelper", "funcTable", "funcCounter", "funcRecurse" })
+    {
+        if (std::find(names.begin(), names.end(), expectedName) == names.end())
+        {
+            fprintf(stderr, "%s isn't exported\n", expectedName);
+            failureCount++;
+        }
+    }
+
+    // The exported symbols, and some that shouldn't be found. helper is internal to the module.
+    std::vector<const char*> lookupNames;
+    for (const auto& name : names)
+    {
+        lookupNames.push_back(name.c_str());
+    }
+    const size_t exportedCount = lookupNames.size();
+    lookupNames.push_back("helper");
+    lookupNames.push_back("notDefined");
+
+    // Individual lookups
+    for (size_t i = 0; i < lookupNames.size(); ++i)
+    {
+        const char* name = lookupNames[i];
+        const bool shouldFind = i < exportedCount;
+        const bool jitFound = jit->findSymbolAddressByName(name) != nullptr;
+        const bool frozenFound = frozen->findSymbolAddressByName(name) != nullptr;
+        if (jitFound != shouldFind || frozenFound != shouldFind)
+        {
+            fprintf(stderr, "%s: found by JIT %d, found frozen %d, expected %d\n", name, int(jitFound), int(frozenFound), int(shouldFind));
+            failureCount++;
+        }
+    }
+
+    // Bulk lookups give the same addresses as individual lookups, and the same result
+    for (ISlangLLVMJITSharedLibrary* library : { jit, frozen })
+    {
+        const char* libraryName = (library == jit) ? "JIT" : "frozen";
+
+        std::vector<void*> addresses(lookupNames.size());
+        const SlangResult res = library->findSymbolAddressesByName(lookupNames.data(), lookupNames.size(), addresses.data());
+        if (res != SLANG_E_NOT_FOUND)
+        {
+            fprintf(stderr, "%s: bulk lookup with missing symbols returned 0x%08x\n", libraryName, unsigned(res));
+            failureCount++;
+        }
+
+        for (size_t i = 0; i < lookupNames.size(); ++i)
+        {
+            void* address = (i < exportedCount) ? library->findSymbolAddressByName(lookupNames[i]) : nullptr;
+            if (addresses[i] != address)
+            {
+                fprintf(stderr, "%s: bulk lookup of %s gave a different address\n", libraryName, lookupNames[i]);
+                failureCount++;
+            }
+        }
+
+        if (SLANG_FAILED(library->findSymbolAddressesByName(lookupNames.data(), exportedCount, addresses.data())))
+        {
+            fprintf(stderr, "%s: bulk lookup of the exported symbols failed\n", libraryName);
+            failureCount++;
+        }
+    }
+
+    // The functions found behave the same
+    for (const auto& name : names)
+    {
+        if (strncmp(name.c_str(), "func", 4) != 0)
+        {
+            continue;
+        }
+
+        auto jitFunc = (IntFunc)jit->findFuncByName(name.c_str());
+        auto frozenFunc = (IntFunc)frozen->findFuncByName(name.c_str());
+        if (!jitFunc || !frozenFunc)
+        {
+            // Already reported
+            continue;
+        }
+
+        for (int value = 0; value < 8; ++value)
+        {
+            const int jitResult = jitFunc(value);
+            const int frozenResult = frozenFunc(value);
+            if (jitResult != frozenResult)
+            {
+                fprintf(stderr, "%s(%d): JIT returned %d, frozen returned %d\n", name.c_str(), value, jitResult, frozenResult);
+                failureCount++;
+            }
+        }
+    }
+
+    // The data found is the data the code uses
+    for (ISlangLLVMJITSharedLibrary* library : { jit, frozen })
+    {
+        const char* libraryName = (library == jit) ? "JIT" : "frozen";
+
+        auto table = (const int*)library->findSymbolAddressByName("table");
+        auto counter = (int*)library->findSymbolAddressByName("counter");
+        auto funcCounter = (IntFunc)library->findFuncByName("funcCounter");
+        if (!table || !counter || !funcCounter)
+        {
+            continue;
+        }
+
+        *counter = 1000;
+        if (table[2] != 13 || funcCounter(1) != 1001 || *counter != 1001)
+        {
+            fprintf(stderr, "%s: the data found isn't the data used by the code\n", libraryName);
+            failureCount++;
+        }
+    }
+
+    printf("%s\n", failureCount ? "FAILED" : "PASSED");
+    return failureCount ? 1 : 0;
+}
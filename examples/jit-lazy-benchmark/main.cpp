@@ -0,0 +1,166 @@
+// Compares the time to first call of eager and lazy (-jit-lazy) compilation.
+//
+// A module with many functions is compiled, and one function is looked up and called. Eagerly, all of the functions
+// are compiled to machine code before the artifact is returned. Lazily, only the function that is called is. The
+// frontend and optimization are the same in both modes, so the difference is code generation.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+#include <core/slang-string.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+typedef int(*KernelFunc)(int value);
+
+struct Mode
+{
+    const char* name;
+    const char* arg;                ///< The slang-llvm argument, or nullptr for none
+};
+
+// salt makes the source of each run different, so nothing is reused from an earlier run
+static void _generateSource(int functionCount, int salt, StringBuilder& out)
+{
+    for (int i = 0; i < functionCount; ++i)
+    {
+        out << "int func" << i << "(int value)\n";
+        out << "{\n";
+        out << "    int sum = " << salt << ";\n";
+        out << "    for (int j = 0; j < value; ++j)\n";
+        out << "    {\n";
+        out << "        sum = sum * " << (i + 3) << " + (j ^ " << i << ");\n";
+        out << "        if (sum & 1) { sum += " << (i * 7) << "; } else { sum -= j; }\n";
+        out << "    }\n";
+        out << "    return sum;\n";
+        out << "}\n\n";
+    }
+}
+
+static SlangResult _compile(IDownstreamCompiler* compiler, const StringBuilder& source, const char* arg, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(source.getUnownedSlice()));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice(arg ? arg : "") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, arg ? 1 : 0);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+static double _getMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, const char* const* argv)
+{
+    int functionCount = 500;
+    if (argc > 1)
+    {
+        functionCount = atoi(argv[1]);
+    }
+    const int runCount = 5;
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    // Every run is compiled from scratch
+    if (auto setBudget = (SetLLVMCompileCacheMemoryBudgetFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMCompileCacheMemoryBudget"))
+    {
+        setBudget(0);
+    }
+
+    const Mode modes[] =
+    {
+        { "eager", nullptr },
+        { "-jit-lazy", "-jit-lazy" },
+    };
+
+    printf("%d functions, best of %d runs\n", functionCount, runCount);
+    printf("%-12s %12s %12s %12s\n", "mode", "compile ms", "1st call ms", "total ms");
+
+    int salt = 0;
+    for (const auto& mode : modes)
+    {
+        double bestCompile = 0.0;
+        double bestFirstCall = 0.0;
+        double bestTotal = 0.0;
+
+        for (int run = 0; run < runCount; ++run)
+        {
+            StringBuilder source;
+            _generateSource(functionCount, ++salt, source);
+
+            const auto start = std::chrono::steady_clock::now();
+
+            ComPtr<ISlangSharedLibrary> library;
+            if (SLANG_FAILED(_compile(compiler, source, mode.arg, library)))
+            {
+                fprintf(stderr, "Compilation failed for %s\n", mode.name);
+                return 1;
+            }
+
+            const auto compiled = std::chrono::steady_clock::now();
+
+            auto func = (KernelFunc)library->findFuncByName("func0");
+            if (!func)
+            {
+                fprintf(stderr, "Unable to find the function for %s\n", mode.name);
+                return 1;
+            }
+            volatile int result = func(10);
+            (void)result;
+
+            const auto called = std::chrono::steady_clock::now();
+
+            const double total = _getMilliseconds(start, called);
+            if (run == 0 || total < bestTotal)
+            {
+                bestCompile = _getMilliseconds(start, compiled);
+                bestFirstCall = _getMilliseconds(compiled, called);
+                bestTotal = total;
+            }
+        }
+
+        printf("%-12s %12.2f %12.2f %12.2f\n", mode.name, bestCompile, bestFirstCall, bestTotal);
+    }
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Measures the gain from lowering the prelude's math functions (such as F32_floor) to LLVM intrinsics.
+//
+// For each function there are two kernels that sum the function over an array. One calls the function directly, so
+// the call is lowered to an intrinsic (or instruction) before optimization. The other calls it through a volatile
+// function pointer, which can't be lowered, so it remains a call to the function in the host - as every call was
+// before lowering was added. The time per element of each is printed, along with the speed up.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+#include <core/slang-string.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+typedef float(*SumFunc)(const float* values, int count);
+
+struct MathFunction
+{
+    const char* name;               ///< The name without the F32_ prefix
+    int paramCount;
+};
+
+static const MathFunction kMathFunctions[] =
+{
+    { "floor", 1 },
+    { "ceil", 1 },
+    { "round", 1 },
+    { "trunc", 1 },
+    { "abs", 1 },
+    { "sqrt", 1 },
+    { "sin", 1 },
+    { "cos", 1 },
+    { "exp", 1 },
+    { "exp2", 1 },
+    { "log", 1 },
+    { "log2", 1 },
+    { "log10", 1 },
+    { "pow", 2 },
+    { "fmod", 2 },
+};
+
+static const int kElementCount = 4096;
+
+// For each function generates <name>_lowered and <name>_host kernels
+static void _generateSource(StringBuilder& out)
+{
+    for (const auto& func : kMathFunctions)
+    {
+        const char* params = (func.paramCount == 1) ? "float" : "float, float";
+        const char* args = (func.paramCount == 1) ? "values[i]" : "values[i], 1.5f";
+
+        out << "float F32_" << func.name << "(" << params << ");\n";
+        out << "static float (*volatile " << func.name << "Ptr)(" << params << ") = F32_" << func.name << ";\n";
+        out << "\n";
+        out << "float " << func.name << "_lowered(const float* values, int count)\n";
+        out << "{\n";
+        out << "    float sum = 0.0f;\n";
+        out << "    for (int i = 0; i < count; ++i) { sum += F32_" << func.name << "(" << args << "); }\n";
+        out << "    return sum;\n";
+        out << "}\n";
+        out << "\n";
+        out << "float " << func.name << "_host(const float* values, int count)\n";
+        out << "{\n";
+        out << "    float sum = 0.0f;\n";
+        out << "    for (int i = 0; i < count; ++i) { sum += " << func.name << "Ptr(" << args << "); }\n";
+        out << "    return sum;\n";
+        out << "}\n";
+        out << "\n";
+    }
+}
+
+static SlangResult _compile(IDownstreamCompiler* compiler, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    StringBuilder source;
+    _generateSource(source);
+
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(source.getUnownedSlice()));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.optimizationLevel = DownstreamCompileOptions::OptimizationLevel::Default;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+// Returns the time per element in ns, and the sum in outSum
+static double _timeSum(SumFunc func, const float* values, int iterationCount, float& outSum)
+{
+    // Warm up, so the first touch of the code and data isn't timed
+    outSum = func(values, kElementCount);
+
+    volatile float sink = 0.0f;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterationCount; ++i)
+    {
+        sink = sink + func(values, kElementCount);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() * 1e9 / (double(iterationCount) * kElementCount);
+}
+
+int main(int argc, const char* const* argv)
+{
+    int iterationCount = 5000;
+    if (argc > 1)
+    {
+        iterationCount = atoi(argv[1]);
+    }
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    ComPtr<ISlangSharedLibrary> library;
+    if (SLANG_FAILED(_compile(compiler, library)))
+    {
+        fprintf(stderr, "Compilation failed\n");
+        return 1;
+    }
+
+    // Positive values, such that all of the functions are defined
+    static float values[kElementCount];
+    for (int i = 0; i < kElementCount; ++i)
+    {
+        values[i] = 0.5f + float(i % 61) * 0.125f;
+    }
+
+    printf("Times are ns per element\n");
+    printf("%-8s %10s %10s %9s\n", "function", "host call", "lowered", "speed up");
+
+    int failureCount = 0;
+    for (const auto& func : kMathFunctions)
+    {
+        StringBuilder loweredName;
+        loweredName << func.name << "_lowered";
+        StringBuilder hostName;
+        hostName << func.name << "_host";
+
+        auto lowered = (SumFunc)library->findFuncByName(loweredName.getBuffer());
+        auto host = (SumFunc)library->findFuncByName(hostName.getBuffer());
+        if (!lowered || !host)
+        {
+            fprintf(stderr, "Unable to find the kernels for %s\n", func.name);
+            return 1;
+        }
+
+        float hostSum = 0.0f;
+        float loweredSum = 0.0f;
+        const double hostNs = _timeSum(host, values, iterationCount, hostSum);
+        const double loweredNs = _timeSum(lowered, values, iterationCount, loweredSum);
+
+        printf("%-8s %10.3f %10.3f %8.2fx\n", func.name, hostNs, loweredNs, hostNs / loweredNs);
+
+        // The lowered functions can be computed differently (by an instruction, or a vector variant), so allow some difference
+        if (fabs(hostSum - loweredSum) > 1e-3 * fabs(hostSum) + 1e-3)
+        {
+            fprintf(stderr, "%s: the lowered sum %g doesn't match the host sum %g\n", func.name, loweredSum, hostSum);
+            failureCount++;
+        }
+    }
+
+    return failureCount ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+// Test of profile guided optimization (-jit-pgo-generate and -jit-pgo-use).
+//
+// A kernel is compiled with -jit-pgo-generate, run and harvested a number of times, with a profile directory set so the
+// profile can be checked on disk. Checks that
+//
+// * harvested counts are written to the profile directory,
+// * harvests are added to the profile held in memory, or read from the directory if it isn't held,
+// * a harvest for a function whose CFG hash differs from the profile replaces its counts,
+// * a matching profile is applied by -jit-pgo-use, and a profile that doesn't match produces a warning.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+
+#include <compiler-core/slang-artifact-associated.h>
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+static const char kKernelSource[] =
+    "int classify(int value)\n"
+    "{\n"
+    "    if (value > 10)\n"
+    "    {\n"
+    "        return value * 2;\n"
+    "    }\n"
+    "    return value + 1;\n"
+    "}\n";
+
+static const char kFunctionName[] = "classify";
+
+typedef int(*ClassifyFunc)(int value);
+
+/// A function's line of a profile file
+struct FunctionProfile
+{
+    std::string cfgHash;
+    std::vector<unsigned long long> counts;
+};
+
+static SlangResult _compile(IDownstreamCompiler* compiler, const char* arg, ComPtr<IArtifact>& outArtifact, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(UnownedStringSlice(kKernelSource)));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice(arg) };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.optimizationLevel = DownstreamCompileOptions::OptimizationLevel::Default;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, 1);
+
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, outArtifact.writeRef()));
+    return outArtifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+static bool _hasWarning(IArtifact* artifact, const char* text)
+{
+    auto diagnostics = findAssociatedRepresentation<IArtifactDiagnostics>(artifact);
+    const Count count = diagnostics ? diagnostics->getCount() : 0;
+    for (Index i = 0; i < count; ++i)
+    {
+        const auto diagnostic = diagnostics->getAt(i);
+        if (diagnostic->severity == ArtifactDiagnostic::Severity::Warning && strstr(diagnostic->text.begin(), text))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The directory should only hold the profile of the kernel
+static std::filesystem::path _findProfilePath(const std::filesystem::path& directory)
+{
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const std::string name = it->path().filename().string();
+        if (name.rfind("slang-llvm-profile-", 0) == 0 && name.find("tmp") == std::string::npos)
+        {
+            return it->path();
+        }
+    }
+    return std::filesystem::path();
+}
+
+static bool _readFunctionProfile(const std::filesystem::path& path, FunctionProfile& outProfile)
+{
+    std::ifstream stream(path);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        size_t countCount = 0;
+        if (!(fields >> name) || name != kFunctionName || !(fields >> outProfile.cfgHash >> countCount))
+        {
+            continue;
+        }
+
+        outProfile.counts.resize(countCount);
+        for (auto& count : outProfile.counts)
+        {
+            fields >> count;
+        }
+        return bool(fields);
+    }
+    return false;
+}
+
+// Change the CFG hash of the function in the profile, as if the profile was collected for a different version of it
+static bool _corruptCFGHash(const std::filesystem::path& path)
+{
+    std::string text;
+    {
+        std::ifstream stream(path);
+        std::ostringstream contents;
+        contents << stream.rdbuf();
+        text = contents.str();
+    }
+
+    // The hash follows the name, and is 16 hex digits
+    const std::string prefix = std::string("\n") + kFunctionName + " ";
+    const size_t pos = text.find(prefix);
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    char& digit = text[pos + prefix.size()];
+    digit = (digit == '0') ? '1' : '0';
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << text;
+    return bool(stream);
+}
+
+int main(int argc, const char* const* argv)
+{
+    SLANG_UNUSED(argc);
+    SLANG_UNUSED(argv);
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+    auto setProfileDirectory = (SetLLVMProfileDirectoryFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMProfileDirectory");
+    auto clearProfiles = (ClearLLVMProfilesFunc)SharedLibrary::findSymbolAddressByName(handle, "clearLLVMProfiles");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || !setProfileDirectory || !clearProfiles ||
+        SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    // Profiles are written to a new directory, which only holds the kernel's profile
+    std::error_code ec;
+    const auto directory = std::filesystem::temp_directory_path(ec) /
+        ("slang-llvm-pgo-test-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    if (ec || SLANG_FAILED(setProfileDirectory(directory.string().c_str())))
+    {
+        fprintf(stderr, "Unable to set the profile directory\n");
+        return 1;
+    }
+
+    ComPtr<IArtifact> artifact;
+    ComPtr<ISlangSharedLibrary> library;
+    if (SLANG_FAILED(_compile(compiler, "-jit-pgo-generate", artifact, library)))
+    {
+        fprintf(stderr, "Compilation with -jit-pgo-generate failed\n");
+        return 1;
+    }
+
+    auto classify = (ClassifyFunc)library->findFuncByName(kFunctionName);
+    auto profile = (ISlangLLVMJITProfile*)library->castAs(ISlangLLVMJITProfile::getTypeGuid());
+    if (!classify || !profile)
+    {
+        fprintf(stderr, "Unable to find the kernel or its profile\n");
+        return 1;
+    }
+
+    int failureCount = 0;
+    std::filesystem::path profilePath;
+
+    // Run callCount times, harvest, and check the entry count in the file is expectedCount
+    auto runAndCheck = [&](const char* step, int callCount, unsigned long long expectedCount)
+    {
+        for (int i = 0; i < callCount; ++i)
+        {
+            volatile int result = classify(20 + i);
+            (void)result;
+        }
+        if (SLANG_FAILED(profile->harvestProfile()))
+        {
+            fprintf(stderr, "%s: harvest failed\n", step);
+            failureCount++;
+            return;
+        }
+
+        profilePath = _findProfilePath(directory);
+
+        FunctionProfile functionProfile;
+        if (profilePath.empty() || !_readFunctionProfile(profilePath, functionProfile) || functionProfile.counts.empty())
+        {
+            fprintf(stderr, "%s: the profile wasn't written\n", step);
+            failureCount++;
+            return;
+        }
+        if (functionProfile.counts[0] != expectedCount)
+        {
+            fprintf(stderr, "%s: entry count is %llu, expected %llu\n", step, functionProfile.counts[0], expectedCount);
+            failureCount++;
+        }
+    };
+
+    runAndCheck("first harvest", 5, 5);
+    runAndCheck("merge with the profile in memory", 2, 7);
+
+    clearProfiles();
+    runAndCheck("merge with the profile read from the directory", 3, 10);
+
+    // The profile doesn't match the function any more, so is replaced rather than added to
+    clearProfiles();
+    if (profilePath.empty() || !_corruptCFGHash(profilePath))
+    {
+        fprintf(stderr, "Unable to change the CFG hash in the profile\n");
+        return 1;
+    }
+    runAndCheck("merge with a mismatched CFG hash", 4, 4);
+
+    library.setNull();
+    artifact.setNull();
+
+    const char* mismatchWarning = "doesn't match any of its functions";
+
+    // The profile matches, so is applied without warnings
+    clearProfiles();
+    if (SLANG_FAILED(_compile(compiler, "-jit-pgo-use", artifact, library)) || !library->findFuncByName(kFunctionName))
+    {
+        fprintf(stderr, "Compilation with -jit-pgo-use failed\n");
+        failureCount++;
+    }
+    else if (_hasWarning(artifact, mismatchWarning) || _hasWarning(artifact, "No profile found"))
+    {
+        fprintf(stderr, "The matching profile wasn't applied\n");
+        failureCount++;
+    }
+
+    // A profile that doesn't match is reported
+    clearProfiles();
+    if (!_corruptCFGHash(profilePath))
+    {
+        fprintf(stderr, "Unable to change the CFG hash in the profile\n");
+        return 1;
+    }
+    if (SLANG_FAILED(_compile(compiler, "-jit-pgo-use", artifact, library)) || !library->findFuncByName(kFunctionName))
+    {
+        fprintf(stderr, "Compilation with a mismatched profile failed\n");
+        failureCount++;
+    }
+    else if (!_hasWarning(artifact, mismatchWarning))
+    {
+        fprintf(stderr, "The mismatched profile wasn't reported\n");
+        failureCount++;
+    }
+
+    library.setNull();
+    artifact.setNull();
+    setProfileDirectory(nullptr);
+    std::filesystem::remove_all(directory, ec);
+
+    printf("%s\n", failureCount ? "FAILED" : "PASSED");
+    return failureCount ? 1 : 0;
+}
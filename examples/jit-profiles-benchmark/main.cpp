@@ -0,0 +1,229 @@
+// Compares compile time and kernel throughput across optimization profiles.
+//
+// The same kernels are compiled with each optimization level (-O0 to -O3, -Os and -Oz) and with some of the pipeline
+// controls (such as -no-vectorize-loops), and the compile time and the time per element of each kernel are printed.
+// The kernels are a loop the vectorizers can handle, a loop with data dependent branches, and a loop that calls a
+// small function, which depends on inlining.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+#include <core/slang-string.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+static const char kKernelSource[] =
+    "void saxpy(float* out, const float* x, const float* y, float a, int count)\n"
+    "{\n"
+    "    for (int i = 0; i < count; ++i)\n"
+    "    {\n"
+    "        out[i] = a * x[i] + y[i];\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "int classify(const float* x, int count)\n"
+    "{\n"
+    "    int total = 0;\n"
+    "    for (int i = 0; i < count; ++i)\n"
+    "    {\n"
+    "        if (x[i] > 8.0f) { total += 3; }\n"
+    "        else if (x[i] > 4.0f) { total -= 1; }\n"
+    "        else { total ^= i; }\n"
+    "    }\n"
+    "    return total;\n"
+    "}\n"
+    "\n"
+    "static float smoothStep(float edge0, float edge1, float value)\n"
+    "{\n"
+    "    float t = (value - edge0) / (edge1 - edge0);\n"
+    "    t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);\n"
+    "    return t * t * (3.0f - 2.0f * t);\n"
+    "}\n"
+    "\n"
+    "float sumSmoothed(const float* x, int count)\n"
+    "{\n"
+    "    float sum = 0.0f;\n"
+    "    for (int i = 0; i < count; ++i)\n"
+    "    {\n"
+    "        sum += smoothStep(2.0f, 12.0f, x[i]);\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n";
+
+typedef void(*SaxpyFunc)(float* out, const float* x, const float* y, float a, int count);
+typedef int(*ClassifyFunc)(const float* x, int count);
+typedef float(*SumSmoothedFunc)(const float* x, int count);
+
+struct Profile
+{
+    const char* name;
+    const char* args[2];            ///< The slang-llvm arguments, nullptr terminated
+};
+
+static const int kElementCount = 4096;
+
+// run is put in a comment, so each compilation has a different source, and nothing is reused from an earlier one
+static SlangResult _compile(IDownstreamCompiler* compiler, const Profile& profile, int run, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    StringBuilder source;
+    source << "// run " << run << "\n";
+    source << kKernelSource;
+
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(source.getUnownedSlice()));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+
+    TerminatedCharSlice args[SLANG_COUNT_OF(profile.args)];
+    Index argCount = 0;
+    for (auto arg : profile.args)
+    {
+        if (arg)
+        {
+            args[argCount++] = TerminatedCharSlice(arg);
+        }
+    }
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, argCount);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+// Returns the time per element in ns. call is run once to warm up, and then iterationCount times.
+template <typename CallT>
+static double _timeKernel(int iterationCount, const CallT& call)
+{
+    call();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterationCount; ++i)
+    {
+        call();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() * 1e9 / (double(iterationCount) * kElementCount);
+}
+
+int main(int argc, const char* const* argv)
+{
+    int iterationCount = 20000;
+    if (argc > 1)
+    {
+        iterationCount = atoi(argv[1]);
+    }
+    const int compileRunCount = 5;
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    // Every compilation is done from scratch
+    if (auto setBudget = (SetLLVMCompileCacheMemoryBudgetFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMCompileCacheMemoryBudget"))
+    {
+        setBudget(0);
+    }
+
+    static float x[kElementCount];
+    static float y[kElementCount];
+    static float out[kElementCount];
+    for (int i = 0; i < kElementCount; ++i)
+    {
+        x[i] = float(i % 17);
+        y[i] = float(i % 5);
+    }
+
+    const Profile profiles[] =
+    {
+        { "-O0", { "-O0", nullptr } },
+        { "-O1", { "-O1", nullptr } },
+        { "-O2", { "-O2", nullptr } },
+        { "-O3", { "-O3", nullptr } },
+        { "-Os", { "-Os", nullptr } },
+        { "-Oz", { "-Oz", nullptr } },
+        { "-O3 no vectorize", { "-O3", "-no-vectorize-loops" } },
+        { "-O3 no unroll", { "-O3", "-no-unroll-loops" } },
+        { "-O2 inline 25", { "-O2", "-inline-threshold=25" } },
+    };
+
+    printf("Compile time is the best of %d compilations, kernel times are ns per element\n", compileRunCount);
+    printf("%-18s %12s %10s %10s %12s\n", "profile", "compile ms", "saxpy", "classify", "sumSmoothed");
+
+    int run = 0;
+    for (const auto& profile : profiles)
+    {
+        ComPtr<ISlangSharedLibrary> library;
+        double bestCompileMs = 0.0;
+
+        for (int i = 0; i < compileRunCount; ++i)
+        {
+            library.setNull();
+
+            const auto start = std::chrono::steady_clock::now();
+            if (SLANG_FAILED(_compile(compiler, profile, ++run, library)))
+            {
+                fprintf(stderr, "Compilation failed for %s\n", profile.name);
+                return 1;
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (i == 0 || elapsed.count() < bestCompileMs)
+            {
+                bestCompileMs = elapsed.count();
+            }
+        }
+
+        auto saxpy = (SaxpyFunc)library->findFuncByName("saxpy");
+        auto classify = (ClassifyFunc)library->findFuncByName("classify");
+        auto sumSmoothed = (SumSmoothedFunc)library->findFuncByName("sumSmoothed");
+        if (!saxpy || !classify || !sumSmoothed)
+        {
+            fprintf(stderr, "Unable to find the kernels for %s\n", profile.name);
+            return 1;
+        }
+
+        volatile float floatSink = 0.0f;
+        volatile int intSink = 0;
+
+        const double saxpyNs = _timeKernel(iterationCount, [&]() { saxpy(out, x, y, 0.5f, kElementCount); });
+        const double classifyNs = _timeKernel(iterationCount, [&]() { intSink = intSink + classify(x, kElementCount); });
+        const double sumSmoothedNs = _timeKernel(iterationCount, [&]() { floatSink = floatSink + sumSmoothed(x, kElementCount); });
+
+        printf("%-18s %12.2f %10.3f %10.3f %12.3f\n", profile.name, bestCompileMs, saxpyNs, classifyNs, sumSmoothedNs);
+    }
+
+    return 0;
+}
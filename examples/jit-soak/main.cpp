@@ -0,0 +1,201 @@
+// Soak test of JIT unloading.
+//
+// Compiles, runs and releases a large number of distinct kernels, printing the resident set size (RSS) of the process
+// as it goes. Each released artifact's code, data and symbols are removed from the shared JIT, so once the process
+// has warmed up RSS should stay flat. Fails if RSS grows by more than an allowance over the run.
+//
+// The kernels are compiled eagerly, and then with -jit-lazy, whose artifacts' JITDylibs are emptied and reused rather
+// than removed.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+#include <core/slang-string.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if SLANG_WINDOWS_FAMILY
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#   include <psapi.h>
+#elif SLANG_APPLE_FAMILY
+#   include <mach/mach.h>
+#else
+#   include <unistd.h>
+#endif
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+typedef int(*KernelFunc)(int value);
+
+// Returns 0 if not available
+static size_t _getResidentSetSize()
+{
+#if SLANG_WINDOWS_FAMILY
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return size_t(counters.WorkingSetSize);
+    }
+    return 0;
+#elif SLANG_APPLE_FAMILY
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+    {
+        return size_t(info.resident_size);
+    }
+    return 0;
+#else
+    // The second field of statm is the resident size in pages
+    size_t residentPages = 0;
+    if (FILE* file = fopen("/proc/self/statm", "r"))
+    {
+        if (fscanf(file, "%*s %zu", &residentPages) != 1)
+        {
+            residentPages = 0;
+        }
+        fclose(file);
+    }
+    return residentPages * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Each kernel has different constants, so every compilation produces new code
+static SlangResult _compileAndRun(IDownstreamCompiler* compiler, int index, const char* arg)
+{
+    StringBuilder source;
+    source << "static int table[4] = { " << index << ", 1, 2, 3 };\n";
+    source << "int kernel(int value)\n";
+    source << "{\n";
+    source << "    return value * " << (index % 1000 + 2) << " + table[value & 3];\n";
+    source << "}\n";
+
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(source.getUnownedSlice()));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice(arg ? arg : "") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, arg ? 1 : 0);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+
+    ComPtr<ISlangSharedLibrary> library;
+    SLANG_RETURN_ON_FAIL(artifact->loadSharedLibrary(ArtifactKeep::Yes, library.writeRef()));
+
+    auto kernel = (KernelFunc)library->findFuncByName("kernel");
+    if (!kernel || kernel(0) != index)
+    {
+        return SLANG_FAIL;
+    }
+
+    // The artifact and library are released here
+    return SLANG_OK;
+}
+
+int main(int argc, const char* const* argv)
+{
+    int kernelCount = 100000;
+    if (argc > 1)
+    {
+        kernelCount = atoi(argv[1]);
+    }
+
+    // RSS is measured from after this many kernels, by which time the JIT, LLVM and the allocator have warmed up
+    const int warmUpCount = (kernelCount < 10000) ? kernelCount / 10 + 1 : 1000;
+    const int reportInterval = (kernelCount < 100) ? 1 : kernelCount / 10;
+    // The growth allowed over the run, for allocator fragmentation and the like
+    const size_t allowedGrowthInBytes = 16 * 1024 * 1024;
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    // The compile cache would hold the object code of kernels up to its budget, so make sure it's disabled
+    if (auto setBudget = (SetLLVMCompileCacheMemoryBudgetFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMCompileCacheMemoryBudget"))
+    {
+        setBudget(0);
+    }
+
+    // nullptr compiles eagerly
+    const char* const modeArgs[] = { nullptr, "-jit-lazy" };
+
+    int failureCount = 0;
+    for (const char* arg : modeArgs)
+    {
+        const char* modeName = arg ? arg : "eager";
+        printf("%s\n", modeName);
+
+        size_t baseRSS = 0;
+        size_t maxRSS = 0;
+        for (int i = 0; i < kernelCount; ++i)
+        {
+            // Each mode has its own kernels, so nothing is shared with the previous mode
+            const int index = (arg ? kernelCount : 0) + i;
+            if (SLANG_FAILED(_compileAndRun(compiler, index, arg)))
+            {
+                fprintf(stderr, "Kernel %d failed (%s)\n", i, modeName);
+                return 1;
+            }
+
+            const int doneCount = i + 1;
+            if (doneCount == warmUpCount)
+            {
+                baseRSS = _getResidentSetSize();
+            }
+
+            if (doneCount % reportInterval == 0)
+            {
+                const size_t rss = _getResidentSetSize();
+                if (doneCount >= warmUpCount && rss > maxRSS)
+                {
+                    maxRSS = rss;
+                }
+                printf("%8d kernels RSS %8.2f MB\n", doneCount, rss / (1024.0 * 1024.0));
+            }
+        }
+
+        if (baseRSS == 0)
+        {
+            printf("RSS is not available on this platform\n");
+            return 0;
+        }
+
+        const size_t growth = (maxRSS > baseRSS) ? maxRSS - baseRSS : 0;
+        printf("RSS grew by %.2f MB after warm up (allowed %.2f MB)\n", growth / (1024.0 * 1024.0), allowedGrowthInBytes / (1024.0 * 1024.0));
+
+        failureCount += (growth > allowedGrowthInBytes) ? 1 : 0;
+    }
+
+    return failureCount ? 1 : 0;
+}
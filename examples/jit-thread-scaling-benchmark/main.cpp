@@ -0,0 +1,185 @@
+// Measures how code generation scales with the number of JIT compile threads (see setLLVMCompileThreadCount).
+//
+// A module with many functions is compiled with -jit-lazy, and then all of its functions are looked up in a single
+// query with findSymbolAddressesByName. With a thread pool the functions are generated in parallel, without one they
+// are generated one after another on the calling thread.
+//
+// The thread count can only be set before the JIT is created, so each thread count is measured in its own process -
+// the example runs itself with "-threads <count>" for each count.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+#include <core/slang-string.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+static const int kFunctionCount = 2000;
+static const int kRunCount = 3;
+
+// salt makes the source of each run different, so nothing is reused from an earlier run
+static void _generateSource(int functionCount, int salt, StringBuilder& out)
+{
+    for (int i = 0; i < functionCount; ++i)
+    {
+        out << "int func" << i << "(const int* values, int count)\n";
+        out << "{\n";
+        out << "    int sum = " << salt << ";\n";
+        out << "    for (int j = 0; j < count; ++j)\n";
+        out << "    {\n";
+        out << "        int value = values[j] * " << (i + 3) << ";\n";
+        out << "        if (value & 1) { sum += value ^ " << i << "; } else { sum -= value >> 2; }\n";
+        out << "        sum = (sum << 1) | (sum >> 31);\n";
+        out << "    }\n";
+        out << "    return sum;\n";
+        out << "}\n\n";
+    }
+}
+
+static SlangResult _compile(IDownstreamCompiler* compiler, const StringBuilder& source, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(source.getUnownedSlice()));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice("-jit-lazy") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, 1);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+// Measures a single thread count, and prints a row of the results
+static int _runThreadCount(int threadCount)
+{
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    // Must be set before anything creates the JIT
+    auto setThreadCount = (SetLLVMCompileThreadCountFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMCompileThreadCount");
+    if (!setThreadCount || SLANG_FAILED(setThreadCount(threadCount)))
+    {
+        fprintf(stderr, "Unable to set the compile thread count\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    // Every run is compiled from scratch
+    if (auto setBudget = (SetLLVMCompileCacheMemoryBudgetFunc)SharedLibrary::findSymbolAddressByName(handle, "setLLVMCompileCacheMemoryBudget"))
+    {
+        setBudget(0);
+    }
+
+    std::vector<std::string> nameStrings;
+    std::vector<const char*> names;
+    for (int i = 0; i < kFunctionCount; ++i)
+    {
+        nameStrings.push_back("func" + std::to_string(i));
+    }
+    for (const auto& name : nameStrings)
+    {
+        names.push_back(name.c_str());
+    }
+    std::vector<void*> addresses(names.size());
+
+    double bestSeconds = 0.0;
+    for (int run = 0; run < kRunCount; ++run)
+    {
+        StringBuilder source;
+        _generateSource(kFunctionCount, run + 1, source);
+
+        ComPtr<ISlangSharedLibrary> library;
+        if (SLANG_FAILED(_compile(compiler, source, library)))
+        {
+            fprintf(stderr, "Compilation failed\n");
+            return 1;
+        }
+
+        auto jitLibrary = (ISlangLLVMJITSharedLibrary*)library->castAs(ISlangLLVMJITSharedLibrary::getTypeGuid());
+        if (!jitLibrary)
+        {
+            fprintf(stderr, "The library doesn't support bulk lookup\n");
+            return 1;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const SlangResult res = jitLibrary->findSymbolAddressesByName(names.data(), names.size(), addresses.data());
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (SLANG_FAILED(res))
+        {
+            fprintf(stderr, "Unable to find all of the functions\n");
+            return 1;
+        }
+
+        if (run == 0 || elapsed.count() < bestSeconds)
+        {
+            bestSeconds = elapsed.count();
+        }
+    }
+
+    printf("%8d %12.2f %12.1f\n", threadCount, bestSeconds * 1000.0, kFunctionCount / bestSeconds);
+    return 0;
+}
+
+int main(int argc, const char* const* argv)
+{
+    if (argc > 2 && strcmp(argv[1], "-threads") == 0)
+    {
+        return _runThreadCount(atoi(argv[2]));
+    }
+
+    printf("%d functions generated with a single lookup, best of %d runs\n", kFunctionCount, kRunCount);
+    printf("%8s %12s %12s\n", "threads", "ms", "funcs/s");
+    fflush(stdout);
+
+    // 0 is the default, where code is generated on the calling thread
+    const int threadCounts[] = { 0, 1, 2, 4, 8, 16 };
+    for (int threadCount : threadCounts)
+    {
+        std::string command = std::string("\"") + argv[0] + "\" -threads " + std::to_string(threadCount);
+        if (system(command.c_str()) != 0)
+        {
+            fprintf(stderr, "Measuring %d threads failed\n", threadCount);
+            return 1;
+        }
+    }
+
+    return 0;
+}
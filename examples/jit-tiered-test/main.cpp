@@ -0,0 +1,169 @@
+// Test of tiered compilation (-jit-tiered).
+//
+// A kernel is compiled tiered, and functions are looked up and called before tier up. Each function returns its own
+// address, which is the address of the code that is running - so a change in the address returned shows the stub
+// that was looked up has been redirected to the tier 1 code. Checks that
+//
+// * calls through the addresses found before tier up switch over to tier 1,
+// * looking functions up again returns the same stubs,
+// * mutable globals are shared, so state from before tier up is kept.
+
+#include <slang.h>
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <core/slang-blob.h>
+#include <core/slang-shared-library.h>
+
+#include <compiler-core/slang-artifact-util.h>
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include "../../source/slang-llvm/slang-llvm.h"
+
+#include <chrono>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Slang;
+
+typedef SlangResult(*CreateLLVMDownstreamCompilerFunc)(const SlangUUID& intfGuid, IDownstreamCompiler** out);
+
+static const char kKernelSource[] =
+    "int counter = 0;\n"
+    "\n"
+    "const void* getCodeAddress()\n"
+    "{\n"
+    "    return (const void*)&getCodeAddress;\n"
+    "}\n"
+    "\n"
+    "int increment(const void** outCodeAddress)\n"
+    "{\n"
+    "    *outCodeAddress = (const void*)&increment;\n"
+    "    return ++counter;\n"
+    "}\n";
+
+typedef const void*(*GetCodeAddressFunc)();
+typedef int(*IncrementFunc)(const void** outCodeAddress);
+
+static SlangResult _compile(IDownstreamCompiler* compiler, ComPtr<ISlangSharedLibrary>& outLibrary)
+{
+    auto sourceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Source, ArtifactPayload::C));
+    sourceArtifact->addRepresentationUnknown(StringBlob::create(UnownedStringSlice(kKernelSource)));
+
+    IArtifact* sourceArtifacts[] = { sourceArtifact };
+    TerminatedCharSlice args[] = { TerminatedCharSlice("-jit-tiered") };
+
+    DownstreamCompileOptions options;
+    options.sourceLanguage = SLANG_SOURCE_LANGUAGE_C;
+    options.targetType = SLANG_SHADER_HOST_CALLABLE;
+    options.optimizationLevel = DownstreamCompileOptions::OptimizationLevel::Default;
+    options.sourceArtifacts = Slice<IArtifact*>(sourceArtifacts, 1);
+    options.compilerSpecificArguments = Slice<TerminatedCharSlice>(args, 1);
+
+    ComPtr<IArtifact> artifact;
+    SLANG_RETURN_ON_FAIL(compiler->compile(options, artifact.writeRef()));
+    return artifact->loadSharedLibrary(ArtifactKeep::Yes, outLibrary.writeRef());
+}
+
+int main(int argc, const char* const* argv)
+{
+    SLANG_UNUSED(argc);
+    SLANG_UNUSED(argv);
+
+    // How long to wait for tier 1 code
+    const auto timeOut = std::chrono::seconds(60);
+
+    SharedLibrary::Handle handle;
+    if (SLANG_FAILED(SharedLibrary::load("slang-llvm", handle)))
+    {
+        fprintf(stderr, "Unable to load slang-llvm\n");
+        return 1;
+    }
+
+    auto createCompiler = (CreateLLVMDownstreamCompilerFunc)SharedLibrary::findSymbolAddressByName(handle, "createLLVMDownstreamCompiler_V4");
+
+    ComPtr<IDownstreamCompiler> compiler;
+    if (!createCompiler || SLANG_FAILED(createCompiler(IDownstreamCompiler::getTypeGuid(), compiler.writeRef())))
+    {
+        fprintf(stderr, "Unable to create the slang-llvm compiler\n");
+        return 1;
+    }
+
+    ComPtr<ISlangSharedLibrary> library;
+    if (SLANG_FAILED(_compile(compiler, library)))
+    {
+        fprintf(stderr, "Compilation failed\n");
+        return 1;
+    }
+
+    auto getCodeAddress = (GetCodeAddressFunc)library->findFuncByName("getCodeAddress");
+    auto increment = (IncrementFunc)library->findFuncByName("increment");
+    auto counter = (int*)library->findSymbolAddressByName("counter");
+    if (!getCodeAddress || !increment || !counter)
+    {
+        fprintf(stderr, "Unable to find the kernel's symbols\n");
+        return 1;
+    }
+
+    const void* tier0Address = getCodeAddress();
+    if (tier0Address == (const void*)getCodeAddress)
+    {
+        // The function was returned directly rather than as a stub, so the target doesn't support tiered compilation
+        printf("Tiered compilation is not supported on this target\n");
+        return 0;
+    }
+
+    // Build up some state in tier 0
+    const int tier0CallCount = 10;
+    const void* incrementTier0Address = nullptr;
+    for (int i = 0; i < tier0CallCount; ++i)
+    {
+        increment(&incrementTier0Address);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const void* tier1Address = tier0Address;
+    while ((tier1Address = getCodeAddress()) == tier0Address)
+    {
+        if (std::chrono::steady_clock::now() - start > timeOut)
+        {
+            fprintf(stderr, "Calls weren't redirected to tier 1 code within %d s\n", int(timeOut.count()));
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    printf("Tiered up after %.1f ms, %p -> %p\n", elapsed.count(), tier0Address, tier1Address);
+
+    int failureCount = 0;
+
+    // All stubs are redirected at the same time, so increment must be on tier 1 too
+    const void* incrementTier1Address = nullptr;
+    const int count = increment(&incrementTier1Address);
+    if (incrementTier1Address == incrementTier0Address)
+    {
+        fprintf(stderr, "increment wasn't redirected to tier 1\n");
+        failureCount++;
+    }
+
+    // Tier 1 uses the tier 0 definition of counter
+    if (count != tier0CallCount + 1 || *counter != count)
+    {
+        fprintf(stderr, "State wasn't kept over tier up, count is %d (counter %d), expected %d\n", count, *counter, tier0CallCount + 1);
+        failureCount++;
+    }
+
+    // Looking up again gives the same stubs
+    if ((void*)getCodeAddress != library->findFuncByName("getCodeAddress") ||
+        (void*)increment != library->findFuncByName("increment") ||
+        (void*)counter != library->findSymbolAddressByName("counter"))
+    {
+        fprintf(stderr, "Looking up after tier up gave different addresses\n");
+        failureCount++;
+    }
+
+    printf("%s\n", failureCount ? "FAILED" : "PASSED");
+    return failureCount ? 1 : 0;
+}
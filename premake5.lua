@@ -554,6 +554,145 @@ example "link-check"
         -- LLVM/Clang need this system library
         links { "version" }
 
+example "jit-counters-benchmark"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-lazy-benchmark"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-thread-scaling-benchmark"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-profiles-benchmark"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-math-benchmark"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-tiered-test"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-frozen-test"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-pgo-test"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+example "jit-soak"
+    kind "ConsoleApp"
+
+    -- slang-llvm is loaded at runtime, as it is by Slang, so it's only needed to run the example
+    dependson { "slang-llvm" }
+
+    includedirs {
+        -- So we can access slang.h
+        slangPath, 
+        -- For core/compiler-core
+        path.join(slangPath, "source")
+    }
+
+    links { "core", "compiler-core" }
+
+    filter { "system:windows" }
+        -- For GetProcessMemoryInfo
+        links { "psapi" }
+
 -- Most of the other projects have more interesting configuration going
 -- on, so let's walk through them in order of increasing complexity.
 --
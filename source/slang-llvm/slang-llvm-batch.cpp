@@ -0,0 +1,91 @@
+// Implementation of compileLLVMBatch_V4, which compiles many independent requests on a thread pool.
+
+#include "slang-llvm.h"
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <slang-com-helper.h>
+#include <slang-com-ptr.h>
+
+#include <compiler-core/slang-artifact-associated.h>
+
+#include <chrono>
+#include <vector>
+
+extern "C" SLANG_DLL_EXPORT SlangResult createLLVMDownstreamCompiler_V4(const SlangUUID& intfGuid, Slang::IDownstreamCompiler** out);
+
+extern "C" SLANG_DLL_EXPORT SlangResult compileLLVMBatch_V4(const Slang::DownstreamCompileOptions* options, size_t count, int threadCount, Slang::IArtifact** outArtifacts, SlangResult* outResults, SlangLLVMBatchCompileStats* outStats)
+{
+    using namespace Slang;
+
+    // The compiler has no state of its own, so a single instance can be used from all threads
+    ComPtr<IDownstreamCompiler> compiler;
+    SLANG_RETURN_ON_FAIL(createLLVMDownstreamCompiler_V4(IDownstreamCompiler::getTypeGuid(), compiler.writeRef()));
+
+    std::vector<SlangResult> results(count, SLANG_OK);
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    {
+        // Each compilation creates its own CompilerInstance and LLVMContext, so they can all run in parallel.
+        // The pool is a shared queue, idle threads take the next compilation - so long compilations don't hold
+        // up the others.
+        llvm::ThreadPoolStrategy strategy;
+        if (threadCount > 0)
+        {
+            strategy = llvm::heavyweight_hardware_concurrency(unsigned(threadCount));
+        }
+        else
+        {
+            // A thread per compilation, up to the number of cores
+            strategy = llvm::heavyweight_hardware_concurrency(unsigned(count));
+            strategy.Limit = true;
+        }
+
+        llvm::ThreadPool threadPool(strategy);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            outArtifacts[i] = nullptr;
+
+            IDownstreamCompiler* compilerPtr = compiler;
+            threadPool.async([=, &results]()
+            {
+                results[i] = compilerPtr->compile(options[i], &outArtifacts[i]);
+            });
+        }
+
+        threadPool.wait();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    uint64_t failureCount = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // A compilation can succeed, but produce an artifact that only holds failing diagnostics
+        bool isFailure = SLANG_FAILED(results[i]);
+        if (!isFailure && outArtifacts[i])
+        {
+            auto diagnostics = findAssociatedRepresentation<IArtifactDiagnostics>(outArtifacts[i]);
+            isFailure = diagnostics && SLANG_FAILED(diagnostics->getResult());
+        }
+        failureCount += isFailure ? 1 : 0;
+
+        if (outResults)
+        {
+            outResults[i] = results[i];
+        }
+    }
+
+    if (outStats)
+    {
+        outStats->compileCount = count;
+        outStats->failureCount = failureCount;
+        outStats->elapsedSeconds = elapsed.count();
+        outStats->compilesPerSecond = elapsed.count() > 0.0 ? double(count) / elapsed.count() : 0.0;
+    }
+
+    return SLANG_OK;
+}
@@ -0,0 +1,222 @@
+#include "slang-llvm-compile-cache.h"
+
+#include "slang-llvm-jit.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/SHA1.h"
+
+#include <core/slang-string-util.h>
+#include <compiler-core/slang-slice-allocator.h>
+
+namespace slang_llvm {
+
+namespace { // anonymous
+
+struct KeyHasher
+{
+    template <typename T>
+    void addValue(const T& value)
+    {
+        m_sha1.update(llvm::ArrayRef<uint8_t>((const uint8_t*)&value, sizeof(value)));
+    }
+    void addString(const UnownedStringSlice& slice)
+    {
+        // Prefix with the length, so that the concatenation of strings is unambiguous
+        addValue(uint64_t(slice.getLength()));
+        m_sha1.update(llvm::StringRef(slice.begin(), slice.getLength()));
+    }
+
+    llvm::SHA1 m_sha1;
+};
+
+} // anonymous
+
+/* static */std::string CompileCache::calcKey(const DownstreamCompileOptions& options, ISlangBlob* sourceBlob)
+{
+    return calcKey(options, StringUtil::getSlice(sourceBlob));
+}
+
+/* static */std::string CompileCache::calcKey(const DownstreamCompileOptions& options, const UnownedStringSlice& source)
+{
+    return calcKeyIgnoringArgs(options, source, nullptr);
+}
+
+/* static */std::string CompileCache::calcKeyIgnoringArgs(const DownstreamCompileOptions& options, const UnownedStringSlice& source, bool (*isIgnored)(const UnownedStringSlice& arg))
+{
+    KeyHasher hasher;
+
+    hasher.addString(source);
+
+    hasher.addValue(options.sourceLanguage);
+    hasher.addValue(options.targetType);
+    hasher.addValue(options.optimizationLevel);
+    hasher.addValue(options.floatingPointMode);
+
+    hasher.addValue(uint64_t(options.defines.count));
+    for (const auto& define : options.defines)
+    {
+        hasher.addString(asStringSlice(define.nameWithSig));
+    }
+
+    hasher.addValue(uint64_t(options.includePaths.count));
+    for (const auto& includePath : options.includePaths)
+    {
+        hasher.addString(asStringSlice(includePath));
+    }
+
+    uint64_t argCount = 0;
+    for (const auto& arg : options.compilerSpecificArguments)
+    {
+        if (!isIgnored || !isIgnored(asStringSlice(arg)))
+        {
+            hasher.addString(asStringSlice(arg));
+            argCount++;
+        }
+    }
+    hasher.addValue(argCount);
+
+    // Line tables are only generated if JIT'd code is registered with debuggers or profilers
+    hasher.addValue(JITSession::getEventListenerFlags() != 0);
+
+    return llvm::toHex(hasher.m_sha1.final(), true);
+}
+
+/* static */std::string CompileCache::combineKeys(const std::vector<std::string>& keys)
+{
+    if (keys.size() == 1)
+    {
+        return keys[0];
+    }
+
+    // The order of the sources is significant, as it determines the order they are added to the JIT
+    KeyHasher hasher;
+    hasher.addValue(uint64_t(keys.size()));
+    for (const auto& key : keys)
+    {
+        hasher.addString(UnownedStringSlice(key.data(), key.size()));
+    }
+    return llvm::toHex(hasher.m_sha1.final(), true);
+}
+
+bool CompileCache::find(const std::string& key, Entry& outEntry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A disabled cache can't hit, so a miss isn't worth counting
+    if (m_budgetBytes == 0)
+    {
+        return false;
+    }
+
+    auto it = m_entryMap.find(key);
+    if (it == m_entryMap.end())
+    {
+        m_missCount++;
+        return false;
+    }
+
+    // Make most recently used
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    outEntry = it->second->second;
+    m_hitCount++;
+    return true;
+}
+
+void CompileCache::add(const std::string& key, const Entry& entry)
+{
+    EntryList evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // If it can't fit there is no point adding
+        if (entry.sizeInBytes > m_budgetBytes)
+        {
+            return;
+        }
+
+        // It could have been added by another thread whilst compiling
+        if (m_entryMap.find(key) != m_entryMap.end())
+        {
+            return;
+        }
+
+        _evict(m_budgetBytes - entry.sizeInBytes, evicted);
+
+        m_entries.push_front(std::make_pair(key, entry));
+        m_entryMap.insert(std::make_pair(key, m_entries.begin()));
+        m_usedBytes += entry.sizeInBytes;
+    }
+    // evicted is released here, without the lock held
+}
+
+void CompileCache::_evict(size_t budgetInBytes, EntryList& outEvicted)
+{
+    while (m_usedBytes > budgetInBytes && !m_entries.empty())
+    {
+        auto last = std::prev(m_entries.end());
+
+        m_usedBytes -= last->second.sizeInBytes;
+        m_entryMap.erase(last->first);
+
+        outEvicted.splice(outEvicted.end(), m_entries, last);
+        m_evictionCount++;
+    }
+}
+
+void CompileCache::setBudget(size_t budgetInBytes)
+{
+    EntryList evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_budgetBytes = budgetInBytes;
+        _evict(budgetInBytes, evicted);
+    }
+}
+
+void CompileCache::clear()
+{
+    EntryList entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries.swap(m_entries);
+        m_entryMap.clear();
+        m_usedBytes = 0;
+    }
+}
+
+void CompileCache::getStats(SlangLLVMCompileCacheStats& outStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    outStats.hitCount = m_hitCount;
+    outStats.missCount = m_missCount;
+    outStats.evictionCount = m_evictionCount;
+    outStats.entryCount = uint64_t(m_entries.size());
+    outStats.usedBytes = uint64_t(m_usedBytes);
+    outStats.budgetBytes = uint64_t(m_budgetBytes);
+}
+
+/* static */CompileCache& CompileCache::getSingleton()
+{
+    static CompileCache cache;
+    return cache;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT void setLLVMCompileCacheMemoryBudget(size_t budgetInBytes)
+{
+    slang_llvm::CompileCache::getSingleton().setBudget(budgetInBytes);
+}
+
+extern "C" SLANG_DLL_EXPORT void getLLVMCompileCacheStats(SlangLLVMCompileCacheStats* outStats)
+{
+    slang_llvm::CompileCache::getSingleton().getStats(*outStats);
+}
+
+extern "C" SLANG_DLL_EXPORT void clearLLVMCompileCache()
+{
+    slang_llvm::CompileCache::getSingleton().clear();
+}
@@ -0,0 +1,93 @@
+#ifndef SLANG_LLVM_COMPILE_CACHE_H
+#define SLANG_LLVM_COMPILE_CACHE_H
+
+#include "slang-llvm.h"
+
+#include <slang-com-ptr.h>
+
+#include <compiler-core/slang-downstream-compiler.h>
+#include <compiler-core/slang-artifact-associated.h>
+
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* A process wide, in memory cache of the results of host callable compilations.
+
+The key is a hash of the source and all of the options that can change the output of a compilation. Note that
+the key does *not* take into account the contents of included files - for Slang generated source, everything
+other than the prelude is contained in the source.
+
+An entry holds the object code of each unit of a compilation, rather than the library produced, so a hit links a
+new library and libraries are released as soon as the application releases them. When the memory held by entries
+exceeds the budget, entries are evicted in least recently used order. */
+class CompileCache
+{
+public:
+    struct Entry
+    {
+        std::vector<std::shared_ptr<const llvm::MemoryBuffer>> objects;    ///< The object code of each unit, in unit order
+        ComPtr<IArtifactDiagnostics> diagnostics;
+        size_t sizeInBytes = 0;
+    };
+
+        /// Calculate the key for the options and source
+    static std::string calcKey(const DownstreamCompileOptions& options, const UnownedStringSlice& source);
+    static std::string calcKey(const DownstreamCompileOptions& options, ISlangBlob* sourceBlob);
+        /// As calcKey, but compiler specific arguments for which isIgnored returns true aren't part of the key
+    static std::string calcKeyIgnoringArgs(const DownstreamCompileOptions& options, const UnownedStringSlice& source, bool (*isIgnored)(const UnownedStringSlice& arg));
+        /// Combine the keys of the sources of a compilation into a key for the compilation. For a single source
+        /// the key is unchanged.
+    static std::string combineKeys(const std::vector<std::string>& keys);
+
+        /// Returns true if found, and makes the entry the most recently used. Updates the hit/miss counts, unless the
+        /// cache is disabled.
+    bool find(const std::string& key, Entry& outEntry);
+        /// Add an entry, evicting entries if necessary to stay within the budget.
+    void add(const std::string& key, const Entry& entry);
+
+        /// Set the budget. 0 disables the cache.
+    void setBudget(size_t budgetInBytes);
+        /// Release all of the entries
+    void clear();
+
+    void getStats(SlangLLVMCompileCacheStats& outStats);
+
+        /// Get the process wide cache
+    static CompileCache& getSingleton();
+
+        /// By default we allow this much memory to be held
+    static const size_t kDefaultBudgetInBytes = 64 * 1024 * 1024;
+
+protected:
+    typedef std::list<std::pair<std::string, Entry>> EntryList;
+
+        /// Must be called with m_mutex locked. Evicted entries are moved into outEvicted, such that they can be
+        /// released without the lock being held.
+    void _evict(size_t budgetInBytes, EntryList& outEvicted);
+
+    std::mutex m_mutex;
+
+    EntryList m_entries;                                            ///< The most recently used entry is at the front
+    std::unordered_map<std::string, EntryList::iterator> m_entryMap;
+
+    size_t m_usedBytes = 0;
+    size_t m_budgetBytes = kDefaultBudgetInBytes;
+
+    uint64_t m_hitCount = 0;
+    uint64_t m_missCount = 0;
+    uint64_t m_evictionCount = 0;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,154 @@
+#include "slang-llvm-counters.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+// The fields of SlangLLVMFunctionCounters
+enum class CounterField : unsigned
+{
+    CallCount,
+    CycleCount,
+    CountOf,
+};
+
+void instrumentModuleWithCounters(Module& module, StringRef countersName, bool cycles, std::vector<std::string>& ioNames)
+{
+    std::vector<Function*> funcs;
+    for (auto& func : module)
+    {
+        // Naked functions can only contain inline assembly
+        if (!func.isDeclaration() && !func.hasFnAttribute(Attribute::Naked))
+        {
+            funcs.push_back(&func);
+        }
+    }
+
+    if (funcs.empty())
+    {
+        return;
+    }
+
+    LLVMContext& context = module.getContext();
+    Type* int32Type = Type::getInt32Ty(context);
+    Type* int64Type = Type::getInt64Ty(context);
+
+    StructType* countersType = StructType::get(int64Type, int64Type);
+    ArrayType* arrayType = ArrayType::get(countersType, funcs.size());
+
+    // Only declared, the JIT resolves it to memory held by the artifact
+    auto counters = new GlobalVariable(module, arrayType, false, GlobalValue::ExternalLinkage, nullptr, countersName);
+
+    auto getCounter = [&](size_t index, CounterField field) -> Constant*
+    {
+        Constant* indices[] = { ConstantInt::get(int32Type, 0), ConstantInt::get(int64Type, index), ConstantInt::get(int32Type, unsigned(field)) };
+        return ConstantExpr::getInBoundsGetElementPtr(arrayType, counters, indices);
+    };
+
+    Function* readCycleCounter = cycles ? Intrinsic::getDeclaration(&module, Intrinsic::readcyclecounter) : nullptr;
+    const MaybeAlign counterAlign(sizeof(uint64_t));
+
+    for (size_t i = 0; i < funcs.size(); ++i)
+    {
+        Function* func = funcs[i];
+        ioNames.push_back(func->getName().str());
+
+        // Counters can be updated from multiple threads, but there is no ordering with anything else
+        IRBuilder<> builder(&*func->getEntryBlock().getFirstInsertionPt());
+        builder.CreateAtomicRMW(AtomicRMWInst::Add, getCounter(i, CounterField::CallCount), ConstantInt::get(int64Type, 1), counterAlign, AtomicOrdering::Monotonic);
+
+        if (!readCycleCounter)
+        {
+            continue;
+        }
+
+        Value* startCycles = builder.CreateCall(readCycleCounter);
+
+        std::vector<ReturnInst*> returns;
+        for (auto& block : *func)
+        {
+            if (auto ret = dyn_cast<ReturnInst>(block.getTerminator()))
+            {
+                returns.push_back(ret);
+            }
+        }
+
+        for (ReturnInst* ret : returns)
+        {
+            // Nothing can come between a musttail call and the return
+            Instruction* insertBefore = ret;
+            if (CallInst* mustTailCall = ret->getParent()->getTerminatingMustTailCall())
+            {
+                insertBefore = mustTailCall;
+            }
+
+            builder.SetInsertPoint(insertBefore);
+            Value* endCycles = builder.CreateCall(readCycleCounter);
+            builder.CreateAtomicRMW(AtomicRMWInst::Add, getCounter(i, CounterField::CycleCount), builder.CreateSub(endCycles, startCycles), counterAlign, AtomicOrdering::Monotonic);
+        }
+    }
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! JITCounters !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void JITCounters::init(std::vector<std::string>&& names)
+{
+    m_names = std::move(names);
+
+    const size_t valueCount = m_names.size() * size_t(CounterField::CountOf);
+    m_values.reset(new std::atomic<uint64_t>[valueCount]);
+    reset();
+
+    m_sortedIndices.resize(m_names.size());
+    for (size_t i = 0; i < m_names.size(); ++i)
+    {
+        m_sortedIndices[i] = uint32_t(i);
+    }
+    std::sort(m_sortedIndices.begin(), m_sortedIndices.end(), [&](uint32_t a, uint32_t b) { return m_names[a] < m_names[b]; });
+}
+
+void JITCounters::get(size_t index, SlangLLVMFunctionCounters& outCounters) const
+{
+    const std::atomic<uint64_t>* values = m_values.get() + index * size_t(CounterField::CountOf);
+    outCounters.callCount = values[size_t(CounterField::CallCount)].load(std::memory_order_relaxed);
+    outCounters.cycleCount = values[size_t(CounterField::CycleCount)].load(std::memory_order_relaxed);
+}
+
+bool JITCounters::find(const char* name, SlangLLVMFunctionCounters& outCounters) const
+{
+    auto it = std::lower_bound(m_sortedIndices.begin(), m_sortedIndices.end(), name, [&](uint32_t index, const char* value) { return ::strcmp(m_names[index].c_str(), value) < 0; });
+
+    outCounters = {};
+
+    bool isFound = false;
+    for (; it != m_sortedIndices.end() && m_names[*it] == name; ++it)
+    {
+        SlangLLVMFunctionCounters counters;
+        get(*it, counters);
+
+        outCounters.callCount += counters.callCount;
+        outCounters.cycleCount += counters.cycleCount;
+        isFound = true;
+    }
+    return isFound;
+}
+
+void JITCounters::reset()
+{
+    const size_t valueCount = m_names.size() * size_t(CounterField::CountOf);
+    for (size_t i = 0; i < valueCount; ++i)
+    {
+        m_values[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace slang_llvm
@@ -0,0 +1,57 @@
+#ifndef SLANG_LLVM_COUNTERS_H
+#define SLANG_LLVM_COUNTERS_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* Instruments every function defined in module to count calls to it (-jit-counters), and if cycles is set the cycles
+from entry to return (-jit-cycle-counters).
+
+Counters are held in host memory owned by the artifact (see JITCounters), rather than the module. The module declares
+countersName as an array of SlangLLVMFunctionCounters, with an element for each function, which the JIT resolves to
+the host memory. The names of the functions, in element order, are added to ioNames.
+
+The module should already be optimized, so only functions that are actually JIT'd are counted, and the counters don't
+change what is inlined or vectorized. */
+void instrumentModuleWithCounters(llvm::Module& module, llvm::StringRef countersName, bool cycles, std::vector<std::string>& ioNames);
+
+/* The counters of the functions of a JIT'd artifact. */
+class JITCounters
+{
+public:
+        /// Allocates (zeroed) counters for each function
+    void init(std::vector<std::string>&& names);
+
+        /// The counters, laid out as an array of SlangLLVMFunctionCounters for the JIT'd code to update
+    void* getData() { return m_values.get(); }
+
+    size_t getCount() const { return m_names.size(); }
+    const char* getName(size_t index) const { return m_names[index].c_str(); }
+
+        /// Read the counters of a function
+    void get(size_t index, SlangLLVMFunctionCounters& outCounters) const;
+        /// Sum the counters of all functions called name. Returns false if there are none.
+    bool find(const char* name, SlangLLVMFunctionCounters& outCounters) const;
+
+    void reset();
+
+protected:
+    std::vector<std::string> m_names;
+        /// Indices of m_names, sorted by name
+    std::vector<uint32_t> m_sortedIndices;
+        /// Two values (call count and cycle count) per function
+    std::unique_ptr<std::atomic<uint64_t>[]> m_values;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,150 @@
+#include "slang-llvm-jit-events.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Process.h"
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! PerfMapEventListener !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void PerfMapEventListener::notifyObjectLoaded(ObjectKey key, const object::ObjectFile& object, const RuntimeDyld::LoadedObjectInfo& info)
+{
+    SLANG_UNUSED(key);
+
+    // The debug object has its sections at their load addresses, so symbol addresses are where the code is
+    object::OwningBinary<object::ObjectFile> debugObjectOwner = info.getObjectForDebug(object);
+    const object::ObjectFile* debugObject = debugObjectOwner.getBinary();
+    if (!debugObject)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_stream)
+    {
+        if (m_isOpenFailed)
+        {
+            return;
+        }
+
+        SmallString<64> path;
+        (Twine("/tmp/perf-") + Twine(uint64_t(sys::Process::getProcessId())) + ".map").toVector(path);
+
+        std::error_code ec;
+        m_stream = std::make_unique<raw_fd_ostream>(path, ec, sys::fs::OF_Append | sys::fs::OF_Text);
+        if (ec)
+        {
+            m_stream.reset();
+            m_isOpenFailed = true;
+            return;
+        }
+    }
+
+    for (const auto& symbolAndSize : object::computeSymbolSizes(*debugObject))
+    {
+        const object::SymbolRef& symbol = symbolAndSize.first;
+
+        auto typeExpected = symbol.getType();
+        if (!typeExpected)
+        {
+            consumeError(typeExpected.takeError());
+            continue;
+        }
+        if (*typeExpected != object::SymbolRef::ST_Function)
+        {
+            continue;
+        }
+
+        auto nameExpected = symbol.getName();
+        auto addressExpected = symbol.getAddress();
+        if (!nameExpected || !addressExpected)
+        {
+            consumeError(nameExpected.takeError());
+            consumeError(addressExpected.takeError());
+            continue;
+        }
+
+        // Format is "start size name", with start and size in hex
+        *m_stream << format_hex_no_prefix(*addressExpected, 1) << " " << format_hex_no_prefix(symbolAndSize.second, 1) << " " << *nameExpected << "\n";
+    }
+
+    // So the map is complete if the process exits (or crashes) while being profiled
+    m_stream->flush();
+}
+
+/* static */PerfMapEventListener* PerfMapEventListener::getSingleton()
+{
+    // Deliberately leaked - objects can be freed during static destruction
+    static PerfMapEventListener* listener = new PerfMapEventListener;
+    return listener;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! Functions !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+SlangResult checkJITEventListenersAvailable(uint32_t flags)
+{
+    const uint32_t allFlags = SLANG_LLVM_JIT_EVENT_LISTENER_GDB | SLANG_LLVM_JIT_EVENT_LISTENER_PERF_MAP | SLANG_LLVM_JIT_EVENT_LISTENER_JITDUMP;
+    if (flags & ~allFlags)
+    {
+        return SLANG_E_INVALID_ARG;
+    }
+
+    // Listeners are registered with RuntimeDyld, which isn't used where LLJIT uses JITLink (see JITSession)
+    const Triple triple(sys::getProcessTriple());
+    if (flags && triple.isOSBinFormatMachO() && triple.getArch() == Triple::aarch64)
+    {
+        return SLANG_E_NOT_AVAILABLE;
+    }
+
+#if !SLANG_LINUX_FAMILY
+    // Only perf reads perf maps
+    if (flags & SLANG_LLVM_JIT_EVENT_LISTENER_PERF_MAP)
+    {
+        return SLANG_E_NOT_AVAILABLE;
+    }
+#endif
+
+#if !LLVM_USE_PERF
+    if (flags & SLANG_LLVM_JIT_EVENT_LISTENER_JITDUMP)
+    {
+        return SLANG_E_NOT_AVAILABLE;
+    }
+#endif
+
+    return SLANG_OK;
+}
+
+void getJITEventListeners(uint32_t flags, std::vector<JITEventListener*>& outListeners)
+{
+    outListeners.clear();
+
+    if (flags & SLANG_LLVM_JIT_EVENT_LISTENER_GDB)
+    {
+        outListeners.push_back(JITEventListener::createGDBRegistrationListener());
+    }
+    if (flags & SLANG_LLVM_JIT_EVENT_LISTENER_PERF_MAP)
+    {
+        outListeners.push_back(PerfMapEventListener::getSingleton());
+    }
+    if (flags & SLANG_LLVM_JIT_EVENT_LISTENER_JITDUMP)
+    {
+        // nullptr if LLVM was built without perf support
+        if (JITEventListener* listener = JITEventListener::createPerfJITEventListener())
+        {
+            outListeners.push_back(listener);
+        }
+    }
+}
+
+} // namespace slang_llvm
@@ -0,0 +1,45 @@
+#ifndef SLANG_LLVM_JIT_EVENTS_H
+#define SLANG_LLVM_JIT_EVENTS_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace slang_llvm {
+
+/* Appends the functions of each object loaded by the JIT to /tmp/perf-<pid>.map, which perf uses to symbolize
+addresses that aren't in a mapped file.
+
+The format has no way to remove functions, so if an address is reused after its object is freed perf may attribute it
+to either function. jitdump doesn't have that problem, but requires post processing with `perf inject`. */
+class PerfMapEventListener : public llvm::JITEventListener
+{
+public:
+    // JITEventListener
+    virtual void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+
+        /// The process wide listener
+    static PerfMapEventListener* getSingleton();
+
+protected:
+    std::mutex m_mutex;
+        /// Opened when the first object is loaded
+    std::unique_ptr<llvm::raw_fd_ostream> m_stream;
+    bool m_isOpenFailed = false;
+};
+
+    /// Returns SLANG_E_NOT_AVAILABLE if any listener in flags (a combination of SlangLLVMJITEventListenerFlag) isn't
+    /// supported by this LLVM build or platform.
+SlangResult checkJITEventListenersAvailable(uint32_t flags);
+
+    /// Get the (process wide) listeners for flags
+void getJITEventListeners(uint32_t flags, std::vector<llvm::JITEventListener*>& outListeners);
+
+} // namespace slang_llvm
+
+#endif
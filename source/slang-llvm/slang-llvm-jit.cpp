@@ -0,0 +1,488 @@
+#include "slang-llvm-jit.h"
+
+#include "slang-llvm.h"
+#include "slang-llvm-jit-events.h"
+#include "slang-llvm-memory.h"
+#include "slang-llvm-object-cache.h"
+#include "slang-llvm-target.h"
+
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace slang_llvm {
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace { // anonymous
+
+// Process wide state for the session. Configuration (such as the compile thread count) is only used when the
+// session is created.
+struct SessionState
+{
+    std::mutex mutex;
+    std::shared_ptr<JITSession> session;
+    std::string errorString;
+    bool isInitialized = false;
+
+    int compileThreadCount = 0;
+        /// Combination of SlangLLVMJITEventListenerFlag
+    uint32_t eventListenerFlags = 0;
+
+        /// Created on first use. Declared after the session, so it's destroyed (waiting for any tasks) first.
+    std::unique_ptr<ThreadPool> backgroundPool;
+};
+
+} // anonymous
+
+static SessionState& _getSessionState()
+{
+    static SessionState state;
+    return state;
+}
+
+// Called if lazy compilation of a function fails. There isn't a way to recover.
+static void _lazyCompileFailed()
+{
+    printf("Clang/LLVM fatal error: lazy compilation of a JIT'd function failed\n");
+    SLANG_BREAKPOINT(0);
+    abort();
+}
+
+template <typename BuilderT>
+static void _initBuilder(BuilderT& builder, JITTargetMachineBuilder jtmb, int compileThreadCount, const std::vector<JITEventListener*>& eventListeners)
+{
+    const Triple triple = jtmb.getTargetTriple();
+
+    // Use the same CPU and features as clang
+    builder.setJITTargetMachineBuilder(std::move(jtmb));
+
+    // With compile threads, materialization (of modules, or lazily compiled functions) is dispatched to a thread
+    // pool, otherwise it happens on the thread that triggers it.
+    if (compileThreadCount > 0)
+    {
+        builder.setNumCompileThreads(unsigned(compileThreadCount));
+    }
+
+    // LLJIT defaults to RuntimeDyld with a memory manager per object, apart from on MachO arm64 where it uses JITLink.
+    // Where RuntimeDyld is used, give each object a memory manager that allocates from the pool, and register the
+    // event listeners. The layer notifies listeners when an object is freed (when its dylib is removed).
+    const bool usesJITLink = triple.isOSBinFormatMachO() && triple.getArch() == Triple::aarch64;
+
+    auto pool = JITMemoryPool::getSingleton();
+    if (!usesJITLink && (pool->isEnabled() || eventListeners.size()))
+    {
+        builder.setObjectLinkingLayerCreator([pool, eventListeners](ExecutionSession& executionSession, const Triple& targetTriple) -> Expected<std::unique_ptr<ObjectLayer>>
+        {
+            auto layer = std::make_unique<RTDyldObjectLinkingLayer>(executionSession, [pool]() -> std::unique_ptr<RuntimeDyld::MemoryManager>
+            {
+                if (pool->isEnabled())
+                {
+                    return std::make_unique<PooledMemoryManager>(pool);
+                }
+                return std::make_unique<SectionMemoryManager>();
+            });
+
+            for (JITEventListener* listener : eventListeners)
+            {
+                layer->registerJITEventListener(*listener);
+            }
+
+            // As LLJIT does for its default layer
+            if (targetTriple.isOSBinFormatCOFF())
+            {
+                layer->setOverrideObjectFlagsWithResponsibilityFlags(true);
+                layer->setAutoClaimResponsibilityForObjectSymbols(true);
+            }
+            return std::unique_ptr<ObjectLayer>(std::move(layer));
+        });
+    }
+
+    // The session is shared between threads, so we need a compiler that can be used concurrently.
+    // The disk object cache is always set - it only stores objects for modules that are identified for it.
+    builder.setCompileFunctionCreator([](JITTargetMachineBuilder jtmb) -> Expected<std::unique_ptr<IRCompileLayer::IRCompiler>>
+    {
+        return std::make_unique<ConcurrentIRCompiler>(std::move(jtmb), &DiskObjectCache::getSingleton());
+    });
+}
+
+/* static */Expected<std::unique_ptr<LLJIT>> JITSession::_createJIT(int compileThreadCount, uint32_t eventListenerFlags, LLLazyJIT*& outLazyJit)
+{
+    /* JS: NOTE!
+
+    It is worth saying there can be some odd issues around creating the JIT - if LLVM-C is linked against.
+
+    If it is then LLVM will likely startup saying LLVM-C isn't found.
+    BUT if you have LLVM *installed* on your system (as is reasonable to do from a LLVM distro, then
+    at startup it *MIGHT* find a LLVM-C dll in that installation (ie nothing to do with the version of LLVM
+    linked with). This will likely lead to an odd error saying the 'triple can't be found' and that no
+    targets are registered.
+
+    Also note that the behavior *may* be different with Debug/Release - because of how the linked resolves symbols
+    that are multiply defined.
+
+    If there are problems creating the JIT, check that LLVM-C is not linked against (it should be disabled in the premake).
+    */
+
+    auto jtmbExpected = TargetCPU::get().createJITTargetMachineBuilder();
+    if (!jtmbExpected)
+    {
+        return jtmbExpected.takeError();
+    }
+
+    std::vector<JITEventListener*> eventListeners;
+    getJITEventListeners(eventListenerFlags, eventListeners);
+
+    // A lazy JIT can compile eagerly or lazily. Lazy compilation requires target specific support (for stubs and
+    // so forth), so if the lazy JIT can't be created we fall back to a regular JIT.
+    {
+        LLLazyJITBuilder jitBuilder;
+        _initBuilder(jitBuilder, *jtmbExpected, compileThreadCount, eventListeners);
+
+        jitBuilder.setLazyCompileFailureAddr(pointerToJITTargetAddress(&_lazyCompileFailed));
+
+        auto lazyJitExpected = jitBuilder.create();
+        if (lazyJitExpected)
+        {
+            outLazyJit = lazyJitExpected->get();
+            return std::unique_ptr<LLJIT>(std::move(*lazyJitExpected));
+        }
+        consumeError(lazyJitExpected.takeError());
+    }
+
+    outLazyJit = nullptr;
+
+    LLJITBuilder jitBuilder;
+    _initBuilder(jitBuilder, *jtmbExpected, compileThreadCount, eventListeners);
+
+    return jitBuilder.create();
+}
+
+/* static */SlangResult JITSession::get(std::shared_ptr<JITSession>& outSession, std::string& outError)
+{
+    auto& state = _getSessionState();
+    auto& session = state.session;
+    auto& errorString = state.errorString;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // The session can be requested before anything has been compiled (for example by addLLVMHostSymbol), so make sure
+    // the native target is registered before the JIT is created
+    if (SLANG_FAILED(initLLVM()))
+    {
+        outError = "Unable to initialize LLVM";
+        return SLANG_FAIL;
+    }
+
+    if (!state.isInitialized)
+    {
+        LLLazyJIT* lazyJit = nullptr;
+        auto expectJit = _createJIT(state.compileThreadCount, state.eventListenerFlags, lazyJit);
+        if (expectJit)
+        {
+            auto newSession = std::make_shared<JITSession>();
+            newSession->m_jit = std::move(*expectJit);
+            newSession->m_lazyJit = lazyJit;
+
+            // The host symbols are only defined once, and shared by all artifacts
+            std::vector<HostSymbol> hostSymbols;
+            getBuiltinHostSymbols(hostSymbols);
+
+            auto hostDylibExpected = newSession->getExecutionSession().createJITDylib("stdc");
+            if (hostDylibExpected)
+            {
+                newSession->m_hostDylib = &*hostDylibExpected;
+
+                if (auto err = newSession->defineSymbols(*newSession->m_hostDylib, hostSymbols.data(), hostSymbols.size()))
+                {
+                    errorString = toString(std::move(err));
+                }
+                else
+                {
+                    session = newSession;
+                    // Only once the session exists, so a failure can be retried (for example after changing settings)
+                    state.isInitialized = true;
+                }
+            }
+            else
+            {
+                errorString = toString(hostDylibExpected.takeError());
+            }
+        }
+        else
+        {
+            errorString = toString(expectJit.takeError());
+        }
+    }
+
+    if (!session)
+    {
+        outError = errorString;
+        return SLANG_FAIL;
+    }
+
+    outSession = session;
+    return SLANG_OK;
+}
+
+/* static */SlangResult JITSession::setCompileThreadCount(int count)
+{
+    auto& state = _getSessionState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // Can only be changed before the session is created
+    if (state.isInitialized)
+    {
+        return SLANG_FAIL;
+    }
+
+    if (count < 0)
+    {
+        count = int(heavyweight_hardware_concurrency().compute_thread_count());
+    }
+
+    state.compileThreadCount = count;
+    return SLANG_OK;
+}
+
+/* static */SlangResult JITSession::setMemoryPool(size_t slabSizeInBytes, bool useHugePages)
+{
+    auto& state = _getSessionState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // The JIT's memory managers are set up when the session is created
+    if (state.isInitialized)
+    {
+        return SLANG_FAIL;
+    }
+
+    JITMemoryPool::getSingleton()->setOptions(slabSizeInBytes, useHugePages);
+    return SLANG_OK;
+}
+
+/* static */SlangResult JITSession::setEventListeners(uint32_t flags)
+{
+    SLANG_RETURN_ON_FAIL(checkJITEventListenersAvailable(flags));
+
+    auto& state = _getSessionState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    // Listeners are registered with the object layer when the session is created
+    if (state.isInitialized)
+    {
+        return SLANG_FAIL;
+    }
+
+    state.eventListenerFlags = flags;
+    return SLANG_OK;
+}
+
+/* static */uint32_t JITSession::getEventListenerFlags()
+{
+    auto& state = _getSessionState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.eventListenerFlags;
+}
+
+/* static */void JITSession::runInBackground(std::function<void()> task)
+{
+    auto& state = _getSessionState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    if (!state.backgroundPool)
+    {
+        state.backgroundPool.reset(new ThreadPool(heavyweight_hardware_concurrency()));
+    }
+    state.backgroundPool->async(std::move(task));
+}
+
+Expected<JITDylib&> JITSession::createArtifactDylib()
+{
+    JITDylib* freeDylib = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_freeDylibsMutex);
+        if (m_freeDylibs.size())
+        {
+            freeDylib = m_freeDylibs.back();
+            m_freeDylibs.pop_back();
+        }
+    }
+
+    if (freeDylib)
+    {
+        // A tiered artifact adds to the link order, so reset it
+        freeDylib->setLinkOrder({ { m_hostDylib, JITDylibLookupFlags::MatchExportedSymbolsOnly } });
+
+        // The symbols the platform defines in each dylib (such as __dso_handle) were removed along with everything else
+        if (Platform* platform = getExecutionSession().getPlatform())
+        {
+            if (auto err = platform->setupJITDylib(*freeDylib))
+            {
+                return std::move(err);
+            }
+        }
+        return *freeDylib;
+    }
+
+    std::string name = "slang-artifact-" + std::to_string(++m_dylibCounter);
+
+    auto dylibExpected = m_jit->createJITDylib(std::move(name));
+    if (dylibExpected)
+    {
+        // Required or the host symbols won't be found
+        dylibExpected->addToLinkOrder(*m_hostDylib);
+    }
+    return dylibExpected;
+}
+
+Error JITSession::removeArtifactDylib(JITDylib& dylib)
+{
+    auto& executionSession = getExecutionSession();
+
+    // Run static destructors (and functions registered with atexit) while the code is still there
+    Error err = m_jit->deinitialize(dylib);
+
+    // Lazily compiled functions are emitted into an ".impl" dylib created by the CompileOnDemandLayer. The layer
+    // holds per dylib state (keyed on the dylib's address) for as long as the session exists, so the dylibs can't be
+    // removed, as another dylib could be created at the same address. Removing the resources of both releases
+    // everything apart from the (empty) dylibs themselves, which are then reused. The layer's state stays valid, as
+    // the dylibs still exist.
+    if (JITDylib* implDylib = executionSession.getJITDylibByName(dylib.getName() + ".impl"))
+    {
+        Error removeErr = joinErrors(implDylib->getDefaultResourceTracker()->remove(), dylib.getDefaultResourceTracker()->remove());
+        if (!removeErr)
+        {
+            std::lock_guard<std::mutex> lock(m_freeDylibsMutex);
+            m_freeDylibs.push_back(&dylib);
+        }
+        err = joinErrors(std::move(err), std::move(removeErr));
+    }
+    else
+    {
+        // Releases the memory for code and data, EH frame registrations, and the symbol table
+        err = joinErrors(std::move(err), executionSession.removeJITDylib(dylib));
+    }
+
+    // Symbol names are interned in a pool shared by the whole session, names that are no longer used need to be
+    // explicitly released
+    executionSession.getSymbolStringPool()->clearDeadEntries();
+
+    return err;
+}
+
+Error JITSession::lookupSymbols(JITDylib& dylib, const char* const* names, size_t count, void** outAddresses)
+{
+    auto& executionSession = getExecutionSession();
+    MangleAndInterner mangler(executionSession, m_jit->getDataLayout());
+
+    std::vector<SymbolStringPtr> mangledNames;
+    mangledNames.reserve(count);
+
+    // Weakly referenced symbols are just missing from the result if they aren't found, rather than failing the lookup
+    SymbolLookupSet lookupSet;
+    for (size_t i = 0; i < count; ++i)
+    {
+        mangledNames.push_back(mangler(names[i]));
+        lookupSet.add(mangledNames.back(), SymbolLookupFlags::WeaklyReferencedSymbol);
+    }
+    lookupSet.removeDuplicates();
+
+    auto symbolsExpected = executionSession.lookup(makeJITDylibSearchOrder(&dylib, JITDylibLookupFlags::MatchAllSymbols), lookupSet);
+    if (!symbolsExpected)
+    {
+        return symbolsExpected.takeError();
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto it = symbolsExpected->find(mangledNames[i]);
+        outAddresses[i] = (it != symbolsExpected->end()) ? jitTargetAddressToPointer<void*>(it->second.getAddress()) : nullptr;
+    }
+    return Error::success();
+}
+
+Error JITSession::removeSymbols(JITDylib& dylib, const char* const* names, size_t count)
+{
+    auto& executionSession = getExecutionSession();
+
+    {
+        MangleAndInterner mangler(executionSession, m_jit->getDataLayout());
+
+        SymbolNameSet nameSet;
+        for (size_t i = 0; i < count; ++i)
+        {
+            nameSet.insert(mangler(names[i]));
+        }
+
+        if (auto err = dylib.remove(nameSet))
+        {
+            return err;
+        }
+    }
+
+    executionSession.getSymbolStringPool()->clearDeadEntries();
+    return Error::success();
+}
+
+Error JITSession::defineSymbols(JITDylib& dylib, const HostSymbol* symbols, size_t count)
+{
+    // Used the following link to test this out
+    // https://www.llvm.org/docs/ORCv2.html
+    // https://www.llvm.org/docs/ORCv2.html#processandlibrarysymbols
+
+    MangleAndInterner mangler(getExecutionSession(), m_jit->getDataLayout());
+
+    SymbolMap symbolMap;
+    for (size_t i = 0; i < count; ++i)
+    {
+        symbolMap.insert(std::make_pair(mangler(symbols[i].name), JITEvaluatedSymbol::fromPointer(symbols[i].address)));
+    }
+
+    return dylib.define(absoluteSymbols(std::move(symbolMap)));
+}
+
+SlangResult JITSession::addHostSymbol(const char* name, void* address)
+{
+    const HostSymbol symbol = { name, address };
+    if (auto err = defineSymbols(*m_hostDylib, &symbol, 1))
+    {
+        consumeError(std::move(err));
+        return SLANG_FAIL;
+    }
+    return SLANG_OK;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult addLLVMHostSymbol(const char* name, void* address)
+{
+    std::shared_ptr<slang_llvm::JITSession> session;
+    std::string errorString;
+    SLANG_RETURN_ON_FAIL(slang_llvm::JITSession::get(session, errorString));
+
+    return session->addHostSymbol(name, address);
+}
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMCompileThreadCount(int count)
+{
+    return slang_llvm::JITSession::setCompileThreadCount(count);
+}
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMJITMemoryPool(size_t slabSizeInBytes, bool useHugePages)
+{
+    return slang_llvm::JITSession::setMemoryPool(slabSizeInBytes, useHugePages);
+}
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMJITEventListeners(uint32_t flags)
+{
+    return slang_llvm::JITSession::setEventListeners(flags);
+}
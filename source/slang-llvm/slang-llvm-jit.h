@@ -0,0 +1,132 @@
+#ifndef SLANG_LLVM_JIT_H
+#define SLANG_LLVM_JIT_H
+
+#include <slang.h>
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* A function (or data) in the host process made available to JIT'd code */
+struct HostSymbol
+{
+    const char* name;           ///< The unmangled name
+    void* address;
+};
+
+/// Get the host symbols that are made available to all JIT'd code. Defined in slang-llvm.cpp, alongside the implementations.
+void getBuiltinHostSymbols(std::vector<HostSymbol>& outSymbols);
+
+/// Register the native target with LLVM, and install the error handler. Only does the work on the first call, and
+/// must be called before anything that needs the target, such as creating the JIT. Defined in slang-llvm.cpp.
+SlangResult initLLVM();
+
+/* A process wide JIT that hosts all JIT'd artifacts.
+
+Creating a LLJIT creates an ExecutionSession, TargetMachine, compile layers and so on, which is relatively slow,
+and holds a significant amount of memory. Instead a single JIT is shared, and each artifact is given its own JITDylib
+such that the symbols of different artifacts are kept separate.
+
+Host symbols are defined once, in the "stdc" JITDylib, and every artifact JITDylib links against it. Embedders can
+add their own host symbols to it with addHostSymbol.
+
+Things that need to outlive the session (such as artifacts) hold a shared_ptr to the session. When an artifact is
+released its dylib is removed, so a long running process doesn't accumulate code from artifacts it no longer uses.
+A dylib that has had lazily compiled modules added can't be removed (see removeArtifactDylib), so it's emptied and
+reused for a later artifact instead.
+
+Unless disabled, code and data are allocated from the process wide JITMemoryPool.
+
+JIT'd objects can be registered with debuggers and profilers (see setEventListeners). Registrations are removed along
+with the dylib holding the object.
+
+The session uses a ConcurrentIRCompiler, so compilations can be performed on multiple threads at the same time. If a
+compile thread count is set, code generation is performed on a thread pool owned by the session.
+
+If the target supports it, the JIT is a LLLazyJIT, which allows modules to be added such that functions are only
+compiled when they are first looked up or called. Modules can also be added to be compiled eagerly as usual. */
+class JITSession
+{
+public:
+        /// Get the process wide session. The session is created on first use. If the session can't be
+        /// created returns a failure and the reason in outError.
+    static SlangResult get(std::shared_ptr<JITSession>& outSession, std::string& outError);
+
+        /// Set the number of threads used to compile (or lazily materialize) modules. 0 compiles on the calling
+        /// thread, a negative count uses a thread per hardware core. Fails if the session has already been created.
+    static SlangResult setCompileThreadCount(int count);
+
+        /// Configure the JITMemoryPool. Fails if the session has already been created.
+    static SlangResult setMemoryPool(size_t slabSizeInBytes, bool useHugePages);
+
+        /// Register JIT'd code with the tools in flags (a combination of SlangLLVMJITEventListenerFlag). Fails if the
+        /// session has already been created.
+    static SlangResult setEventListeners(uint32_t flags);
+        /// The flags set with setEventListeners
+    static uint32_t getEventListenerFlags();
+
+        /// Run a task on a process wide background thread pool. Tasks still queued or running when the process exits
+        /// are waited for, so they shouldn't keep artifacts alive.
+    static void runInBackground(std::function<void()> task);
+
+        /// Create a JITDylib to hold an artifact, reusing an empty one released by a lazy artifact if there is one. It
+        /// links against the host dylib.
+    llvm::Expected<llvm::orc::JITDylib&> createArtifactDylib();
+
+        /// Release a dylib created with createArtifactDylib. Static destructors are run, and then the memory for code
+        /// and data, EH frame registrations and symbols are released. The dylib can't be used afterwards.
+        /// The CompileOnDemandLayer holds state for the dylibs lazy modules are added to (and their ".impl" dylibs) for
+        /// the life of the session, so such a dylib is emptied rather than removed, and is reused by createArtifactDylib.
+        /// Apart from the dylibs, which are reused, a stub and trampoline per lazily compiled function are not released.
+    llvm::Error removeArtifactDylib(llvm::orc::JITDylib& dylib);
+
+        /// Look up count symbols in the dylib with a single query, materializing them if necessary. The address of a
+        /// symbol that isn't found is nullptr.
+    llvm::Error lookupSymbols(llvm::orc::JITDylib& dylib, const char* const* names, size_t count, void** outAddresses);
+        /// Remove materialized symbols from the dylib's symbol table. The memory they are in is still held by the dylib.
+    llvm::Error removeSymbols(llvm::orc::JITDylib& dylib, const char* const* names, size_t count);
+
+        /// Define symbols at addresses in the host in dylib (only)
+    llvm::Error defineSymbols(llvm::orc::JITDylib& dylib, const HostSymbol* symbols, size_t count);
+
+        /// Make a host symbol available to all JIT'd code. Fails if a symbol with the name is already defined.
+    SlangResult addHostSymbol(const char* name, void* address);
+
+        /// True if modules can be added with addLazyIRModule
+    bool isLazySupported() const { return m_lazyJit != nullptr; }
+        /// Add a module such that functions are compiled on first use. Can only be used if isLazySupported.
+    llvm::Error addLazyIRModule(llvm::orc::JITDylib& dylib, llvm::orc::ThreadSafeModule module) { return m_lazyJit->addLazyIRModule(dylib, std::move(module)); }
+
+        /// The dylib holding the host symbols
+    llvm::orc::JITDylib& getHostDylib() { return *m_hostDylib; }
+
+    llvm::orc::LLJIT& getJIT() { return *m_jit; }
+    llvm::orc::ExecutionSession& getExecutionSession() { return m_jit->getExecutionSession(); }
+
+protected:
+    static llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> _createJIT(int compileThreadCount, uint32_t eventListenerFlags, llvm::orc::LLLazyJIT*& outLazyJit);
+
+    std::unique_ptr<llvm::orc::LLJIT> m_jit;
+        /// Set if m_jit is a LLLazyJIT
+    llvm::orc::LLLazyJIT* m_lazyJit = nullptr;
+    llvm::orc::JITDylib* m_hostDylib = nullptr;
+
+        /// Used to produce unique names for artifact JITDylibs
+    std::atomic<uint64_t> m_dylibCounter{0};
+
+        /// Guards m_freeDylibs
+    std::mutex m_freeDylibsMutex;
+        /// Emptied dylibs released by lazy artifacts, for reuse
+    std::vector<llvm::orc::JITDylib*> m_freeDylibs;
+};
+
+} // namespace slang_llvm
+
+#endif
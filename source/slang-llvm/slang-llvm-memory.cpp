@@ -0,0 +1,366 @@
+#include "slang-llvm-memory.h"
+
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+
+#include <algorithm>
+
+#if SLANG_LINUX_FAMILY
+#   include <sys/mman.h>
+#endif
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+// The size of a huge page on the platforms where huge pages are used
+static const size_t _hugePageSize = 2 * 1024 * 1024;
+
+static const unsigned _readWriteFlags = sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+
+static size_t _getPageSize()
+{
+    static const size_t pageSize = size_t(sys::Process::getPageSizeEstimate());
+    return pageSize;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! JITMemoryPool !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+JITMemoryPool::Slab* JITMemoryPool::_createSlab(Kind kind, size_t minSize)
+{
+    const size_t pageSize = _getPageSize();
+    const size_t alignment = m_useHugePages ? std::max(_hugePageSize, pageSize) : pageSize;
+
+    const size_t size = alignTo(std::max(m_slabSize, minSize), alignment);
+
+    // Over allocate so the slab can be aligned
+    const size_t mappedSize = size + (alignment > pageSize ? alignment : 0);
+
+    std::error_code ec;
+    auto mapping = sys::Memory::allocateMappedMemory(mappedSize, nullptr, _readWriteFlags, ec);
+    if (ec)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Slab> slab(new Slab);
+    slab->mapping = mapping;
+    slab->base = (uint8_t*)alignTo(uintptr_t(mapping.base()), alignment);
+    slab->size = size;
+    slab->freeRanges[0] = size;
+
+#if SLANG_LINUX_FAMILY
+    if (m_useHugePages)
+    {
+        // Only a hint, if transparent huge pages aren't available the slab just uses regular pages
+        ::madvise(slab->base, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    auto& slabs = m_slabs[size_t(kind)];
+    slabs.push_back(std::move(slab));
+    return slabs.back().get();
+}
+
+/* static */uint8_t* JITMemoryPool::_allocateFromSlab(Slab& slab, size_t size)
+{
+    // First fit. As blocks are page granular and kernels are typically small there are few free ranges.
+    for (auto it = slab.freeRanges.begin(); it != slab.freeRanges.end(); ++it)
+    {
+        if (it->second >= size)
+        {
+            const size_t offset = it->first;
+            const size_t remaining = it->second - size;
+
+            slab.freeRanges.erase(it);
+            if (remaining)
+            {
+                slab.freeRanges[offset + size] = remaining;
+            }
+
+            slab.usedBytes += size;
+            return slab.base + offset;
+        }
+    }
+    return nullptr;
+}
+
+/* static */void JITMemoryPool::_releaseSlab(Slab& slab)
+{
+    sys::Memory::releaseMappedMemory(slab.mapping);
+}
+
+sys::MemoryBlock JITMemoryPool::allocate(Kind kind, size_t size)
+{
+    size = alignTo(std::max(size, size_t(1)), _getPageSize());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& slab : m_slabs[size_t(kind)])
+    {
+        if (uint8_t* ptr = _allocateFromSlab(*slab, size))
+        {
+            return sys::MemoryBlock(ptr, size);
+        }
+    }
+
+    Slab* slab = _createSlab(kind, size);
+    if (!slab)
+    {
+        return sys::MemoryBlock();
+    }
+    return sys::MemoryBlock(_allocateFromSlab(*slab, size), size);
+}
+
+void JITMemoryPool::free(Kind kind, const sys::MemoryBlock& block)
+{
+    uint8_t* ptr = (uint8_t*)block.base();
+    if (!ptr)
+    {
+        return;
+    }
+
+    // Freed code shouldn't remain executable, and the next user needs to be able to write to it
+    sys::Memory::protectMappedMemory(block, _readWriteFlags);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& slabs = m_slabs[size_t(kind)];
+    for (auto slabIt = slabs.begin(); slabIt != slabs.end(); ++slabIt)
+    {
+        Slab& slab = **slabIt;
+        if (ptr < slab.base || ptr >= slab.base + slab.size)
+        {
+            continue;
+        }
+
+        size_t offset = size_t(ptr - slab.base);
+        size_t size = block.allocatedSize();
+
+        slab.usedBytes -= size;
+
+        // Coalesce with the following and preceding free ranges
+        auto next = slab.freeRanges.lower_bound(offset);
+        if (next != slab.freeRanges.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = slab.freeRanges.erase(next);
+        }
+        if (next != slab.freeRanges.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                offset = prev->first;
+                size += prev->second;
+                slab.freeRanges.erase(prev);
+            }
+        }
+        slab.freeRanges[offset] = size;
+
+        // Keep one slab around, so compiling and releasing an artifact doesn't map and unmap a slab each time
+        if (slab.usedBytes == 0 && slabs.size() > 1)
+        {
+            _releaseSlab(slab);
+            slabs.erase(slabIt);
+        }
+        return;
+    }
+}
+
+void JITMemoryPool::addRequestedBytes(size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requestedBytes += size;
+}
+
+void JITMemoryPool::removeRequestedBytes(size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requestedBytes -= size;
+}
+
+void JITMemoryPool::setOptions(size_t slabSizeInBytes, bool useHugePages)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slabSize = slabSizeInBytes;
+    m_useHugePages = useHugePages;
+}
+
+bool JITMemoryPool::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slabSize != 0;
+}
+
+void JITMemoryPool::getStats(SlangLLVMJITMemoryStats* outStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    SlangLLVMJITMemoryStats stats = {};
+
+    for (const auto& slabs : m_slabs)
+    {
+        for (const auto& slab : slabs)
+        {
+            stats.slabCount++;
+            stats.reservedBytes += slab->size;
+            stats.usedBytes += slab->usedBytes;
+
+            for (const auto& pair : slab->freeRanges)
+            {
+                stats.freeRangeCount++;
+                stats.largestFreeRangeBytes = std::max(stats.largestFreeRangeBytes, uint64_t(pair.second));
+            }
+        }
+    }
+    stats.requestedBytes = m_requestedBytes;
+
+    const uint64_t freeBytes = stats.reservedBytes - stats.usedBytes;
+    stats.fragmentation = freeBytes ? (1.0 - double(stats.largestFreeRangeBytes) / double(freeBytes)) : 0.0;
+
+    *outStats = stats;
+}
+
+JITMemoryPool::~JITMemoryPool()
+{
+    for (auto& slabs : m_slabs)
+    {
+        for (auto& slab : slabs)
+        {
+            _releaseSlab(*slab);
+        }
+    }
+}
+
+/* static */std::shared_ptr<JITMemoryPool> JITMemoryPool::getSingleton()
+{
+    static std::shared_ptr<JITMemoryPool> pool = std::make_shared<JITMemoryPool>();
+    return pool;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! PooledMemoryManager !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+bool PooledMemoryManager::_addRegion(JITMemoryPool::Kind kind, size_t size)
+{
+    Region region;
+    region.block = m_pool->allocate(kind, size);
+    if (!region.block.base())
+    {
+        return false;
+    }
+    m_regions[size_t(kind)].push_back(region);
+    return true;
+}
+
+uint8_t* PooledMemoryManager::_allocate(JITMemoryPool::Kind kind, uintptr_t size, unsigned alignment)
+{
+    alignment = std::max(alignment, 1u);
+
+    auto& regions = m_regions[size_t(kind)];
+
+    // Everything should fit in the space reserved up front, but if not, add another region
+    bool fits = false;
+    if (!regions.empty())
+    {
+        const Region& region = regions.back();
+        const uintptr_t base = uintptr_t(region.block.base());
+        fits = alignTo(base + region.usedBytes, alignment) + size <= base + region.block.allocatedSize();
+    }
+
+    if (!fits && !_addRegion(kind, size + alignment))
+    {
+        return nullptr;
+    }
+
+    Region& region = regions.back();
+    const uintptr_t base = uintptr_t(region.block.base());
+    const uintptr_t start = alignTo(base + region.usedBytes, alignment);
+    region.usedBytes = size_t(start + size - base);
+
+    m_requestedBytes += size;
+    m_pool->addRequestedBytes(size);
+
+    return (uint8_t*)start;
+}
+
+uint8_t* PooledMemoryManager::allocateCodeSection(uintptr_t size, unsigned alignment, unsigned sectionID, StringRef sectionName)
+{
+    SLANG_UNUSED(sectionID);
+    SLANG_UNUSED(sectionName);
+    return _allocate(JITMemoryPool::Kind::Code, size, alignment);
+}
+
+uint8_t* PooledMemoryManager::allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID, StringRef sectionName, bool isReadOnly)
+{
+    SLANG_UNUSED(sectionID);
+    SLANG_UNUSED(sectionName);
+    return _allocate(isReadOnly ? JITMemoryPool::Kind::ReadOnlyData : JITMemoryPool::Kind::ReadWriteData, size, alignment);
+}
+
+void PooledMemoryManager::reserveAllocationSpace(uintptr_t codeSize, uint32_t codeAlign, uintptr_t roDataSize, uint32_t roDataAlign, uintptr_t rwDataSize, uint32_t rwDataAlign)
+{
+    // Failure isn't reported here, allocation will try again
+    const uintptr_t sizes[] = { codeSize + codeAlign, roDataSize + roDataAlign, rwDataSize + rwDataAlign };
+    for (size_t i = 0; i < SLANG_COUNT_OF(sizes); ++i)
+    {
+        if (sizes[i] > 0)
+        {
+            _addRegion(JITMemoryPool::Kind(i), sizes[i]);
+        }
+    }
+}
+
+bool PooledMemoryManager::finalizeMemory(std::string* errorMessage)
+{
+    struct KindFlags
+    {
+        JITMemoryPool::Kind kind;
+        unsigned flags;
+    };
+    const KindFlags kindFlags[] =
+    {
+        { JITMemoryPool::Kind::Code, sys::Memory::MF_READ | sys::Memory::MF_EXEC },
+        { JITMemoryPool::Kind::ReadOnlyData, sys::Memory::MF_READ },
+    };
+
+    for (const auto& kindFlag : kindFlags)
+    {
+        for (const auto& region : m_regions[size_t(kindFlag.kind)])
+        {
+            if (auto ec = sys::Memory::protectMappedMemory(region.block, kindFlag.flags))
+            {
+                if (errorMessage)
+                {
+                    *errorMessage = ec.message();
+                }
+                return true;
+            }
+
+            if (kindFlag.kind == JITMemoryPool::Kind::Code)
+            {
+                sys::Memory::InvalidateInstructionCache(region.block.base(), region.block.allocatedSize());
+            }
+        }
+    }
+    return false;
+}
+
+PooledMemoryManager::~PooledMemoryManager()
+{
+    for (size_t i = 0; i < size_t(JITMemoryPool::Kind::CountOf); ++i)
+    {
+        for (const auto& region : m_regions[i])
+        {
+            m_pool->free(JITMemoryPool::Kind(i), region.block);
+        }
+    }
+    m_pool->removeRequestedBytes(m_requestedBytes);
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT void getLLVMJITMemoryStats(SlangLLVMJITMemoryStats* outStats)
+{
+    slang_llvm::JITMemoryPool::getSingleton()->getStats(outStats);
+}
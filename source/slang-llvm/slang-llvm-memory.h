@@ -0,0 +1,119 @@
+#ifndef SLANG_LLVM_MEMORY_H
+#define SLANG_LLVM_MEMORY_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Memory.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace slang_llvm {
+
+/* A process wide pool of memory for JIT'd code and data.
+
+By default the JIT maps separate small regions for each object it loads. With thousands of small kernels that
+fragments the address space, and multiplies the number of page table entries and iTLB misses. Instead, the pool maps
+large slabs, and hands out page aligned blocks from them.
+
+Code, read only data and read write data are held in separate slabs, as their pages have different protections. As
+the code of all objects is held together, it can be covered by few TLB entries. Optionally slabs are backed by
+transparent huge pages (on Linux) - note the kernel can only use a huge page for a range with the same protection.
+
+Freed blocks are returned to their slab (coalescing with neighbouring free blocks), and a slab that becomes entirely
+free is released, unless it's the only slab of its kind. */
+class JITMemoryPool
+{
+public:
+    enum class Kind
+    {
+        Code,
+        ReadOnlyData,
+        ReadWriteData,
+        CountOf,
+    };
+
+        /// Allocate a block of at least size bytes. The block is page aligned, and readable and writable.
+        /// On failure the block's base is nullptr.
+    llvm::sys::MemoryBlock allocate(Kind kind, size_t size);
+        /// Return a block from allocate to the pool
+    void free(Kind kind, const llvm::sys::MemoryBlock& block);
+
+        /// Track the bytes the JIT actually asked for, to determine how much is lost to rounding
+    void addRequestedBytes(size_t size);
+    void removeRequestedBytes(size_t size);
+
+        /// Set the size of slabs. 0 disables the pool. Only slabs created afterwards are affected.
+    void setOptions(size_t slabSizeInBytes, bool useHugePages);
+        /// True if the JIT should allocate from the pool
+    bool isEnabled();
+
+    void getStats(SlangLLVMJITMemoryStats* outStats);
+
+        /// Memory managers hold a reference to the pool, so it outlives them
+    static std::shared_ptr<JITMemoryPool> getSingleton();
+
+    ~JITMemoryPool();
+
+protected:
+    struct Slab
+    {
+        llvm::sys::MemoryBlock mapping;             ///< The mapping, which may be larger than the slab to allow for alignment
+        uint8_t* base = nullptr;
+        size_t size = 0;
+        size_t usedBytes = 0;
+        std::map<size_t, size_t> freeRanges;        ///< Maps offset to size
+    };
+
+    Slab* _createSlab(Kind kind, size_t minSize);
+    static uint8_t* _allocateFromSlab(Slab& slab, size_t size);
+    static void _releaseSlab(Slab& slab);
+
+    std::mutex m_mutex;
+
+    size_t m_slabSize = 16 * 1024 * 1024;
+    bool m_useHugePages = false;
+
+    std::vector<std::unique_ptr<Slab>> m_slabs[size_t(Kind::CountOf)];
+    size_t m_requestedBytes = 0;
+};
+
+/* A RuntimeDyld memory manager for a single object, that allocates from a JITMemoryPool.
+
+RuntimeDyld reports the total space needed for an object up front, so each kind of section is allocated in a single
+contiguous block. */
+class PooledMemoryManager : public llvm::RTDyldMemoryManager
+{
+public:
+    // RuntimeDyld::MemoryManager
+    virtual uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName) override;
+    virtual uint8_t* allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName, bool isReadOnly) override;
+    virtual bool needsToReserveAllocationSpace() override { return true; }
+    virtual void reserveAllocationSpace(uintptr_t codeSize, uint32_t codeAlign, uintptr_t roDataSize, uint32_t roDataAlign, uintptr_t rwDataSize, uint32_t rwDataAlign) override;
+    virtual bool finalizeMemory(std::string* errorMessage) override;
+
+    explicit PooledMemoryManager(std::shared_ptr<JITMemoryPool> pool) : m_pool(std::move(pool)) {}
+    ~PooledMemoryManager();
+
+protected:
+        /// A block from the pool, and how much of it has been used
+    struct Region
+    {
+        llvm::sys::MemoryBlock block;
+        size_t usedBytes = 0;
+    };
+
+    uint8_t* _allocate(JITMemoryPool::Kind kind, uintptr_t size, unsigned alignment);
+    bool _addRegion(JITMemoryPool::Kind kind, size_t size);
+
+    std::vector<Region> m_regions[size_t(JITMemoryPool::Kind::CountOf)];
+    size_t m_requestedBytes = 0;
+    std::shared_ptr<JITMemoryPool> m_pool;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,167 @@
+#include "slang-llvm-metrics.h"
+
+#include "llvm/ADT/Statistic.h"
+
+#include <chrono>
+
+#if SLANG_WINDOWS_FAMILY
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+namespace slang_llvm {
+
+static double _getWallSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double _getThreadCPUSeconds()
+{
+#if SLANG_WINDOWS_FAMILY
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!::GetThreadTimes(::GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0.0;
+    }
+    // In 100ns units
+    const auto toTicks = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    return double(toTicks(kernelTime) + toTicks(userTime)) * 1e-7;
+#else
+    timespec time;
+    if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+    {
+        return 0.0;
+    }
+    return double(time.tv_sec) + double(time.tv_nsec) * 1e-9;
+#endif
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! PhaseTimer !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+PhaseTimer::PhaseTimer(SlangLLVMPhaseTime& ioTime) :
+    m_time(&ioTime),
+    m_startWallSeconds(_getWallSeconds()),
+    m_startCPUSeconds(_getThreadCPUSeconds())
+{
+}
+
+void PhaseTimer::stop()
+{
+    if (m_time)
+    {
+        m_time->wallSeconds += _getWallSeconds() - m_startWallSeconds;
+        m_time->cpuSeconds += _getThreadCPUSeconds() - m_startCPUSeconds;
+        m_time = nullptr;
+    }
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! Functions !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void addModuleCounts(const llvm::Module& module, SlangLLVMModuleCounts& ioCounts)
+{
+    for (const auto& func : module)
+    {
+        if (!func.isDeclaration())
+        {
+            ioCounts.functionCount++;
+            ioCounts.basicBlockCount += func.size();
+            ioCounts.instructionCount += func.getInstructionCount();
+        }
+    }
+}
+
+static void _addCounts(const SlangLLVMModuleCounts& counts, SlangLLVMModuleCounts& ioCounts)
+{
+    ioCounts.functionCount += counts.functionCount;
+    ioCounts.basicBlockCount += counts.basicBlockCount;
+    ioCounts.instructionCount += counts.instructionCount;
+}
+
+void addUnitMetrics(const SlangLLVMCompileMetrics& unitMetrics, SlangLLVMCompileMetrics& ioMetrics)
+{
+    for (int i = 0; i < SLANG_LLVM_COMPILE_PHASE_COUNT_OF; ++i)
+    {
+        if (i != SLANG_LLVM_COMPILE_PHASE_TOTAL)
+        {
+            ioMetrics.phases[i].wallSeconds += unitMetrics.phases[i].wallSeconds;
+            ioMetrics.phases[i].cpuSeconds += unitMetrics.phases[i].cpuSeconds;
+        }
+    }
+
+    _addCounts(unitMetrics.beforeOptimization, ioMetrics.beforeOptimization);
+    _addCounts(unitMetrics.afterOptimization, ioMetrics.afterOptimization);
+
+    ioMetrics.translationUnitCount++;
+    ioMetrics.objectCacheHitCount += unitMetrics.objectCacheHitCount;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! StatisticsSnapshot !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void StatisticsSnapshot::capture()
+{
+    m_values.clear();
+    for (const auto& pair : llvm::GetStatistics())
+    {
+        m_values[pair.first.str()] += uint64_t(pair.second);
+    }
+}
+
+StatisticsSnapshot::Values StatisticsSnapshot::getChangesSince(const StatisticsSnapshot& earlier) const
+{
+    Values changes;
+    for (const auto& pair : m_values)
+    {
+        // A statistic is only registered the first time it's changed, so may not be in the earlier snapshot
+        auto it = earlier.m_values.find(pair.first);
+        const uint64_t earlierValue = (it != earlier.m_values.end()) ? it->second : 0;
+
+        if (pair.second != earlierValue)
+        {
+            changes.push_back(std::make_pair(pair.first, pair.second - earlierValue));
+        }
+    }
+    return changes;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! CompileMetrics !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+ISlangUnknown* CompileMetrics::getInterface(const Guid& guid)
+{
+    if (guid == ISlangUnknown::getTypeGuid() ||
+        guid == ISlangCastable::getTypeGuid() ||
+        guid == ISlangLLVMCompileMetrics::getTypeGuid())
+    {
+        return static_cast<ISlangLLVMCompileMetrics*>(this);
+    }
+    return nullptr;
+}
+
+void* CompileMetrics::getObject(const Guid& guid)
+{
+    SLANG_UNUSED(guid);
+    return nullptr;
+}
+
+void* CompileMetrics::castAs(const Guid& guid)
+{
+    if (auto ptr = getInterface(guid))
+    {
+        return ptr;
+    }
+    return getObject(guid);
+}
+
+const char* CompileMetrics::getStatisticName(size_t index)
+{
+    return (index < m_statistics.size()) ? m_statistics[index].first.c_str() : nullptr;
+}
+
+uint64_t CompileMetrics::getStatisticValue(size_t index)
+{
+    return (index < m_statistics.size()) ? m_statistics[index].second : 0;
+}
+
+} // namespace slang_llvm
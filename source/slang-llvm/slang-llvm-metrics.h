@@ -0,0 +1,93 @@
+#ifndef SLANG_LLVM_METRICS_H
+#define SLANG_LLVM_METRICS_H
+
+#include "slang-llvm.h"
+
+#include <core/slang-com-object.h>
+
+#include "llvm/IR/Module.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* Measures the wall time, and the CPU time of the current thread, from construction until stopped (or destroyed).
+The times are added to the phase time. Must be stopped on the thread it was constructed on. */
+class PhaseTimer
+{
+public:
+        /// Stop timing, adding the time to the phase. Subsequent calls do nothing.
+    void stop();
+
+    explicit PhaseTimer(SlangLLVMPhaseTime& ioTime);
+    ~PhaseTimer() { stop(); }
+
+protected:
+    SlangLLVMPhaseTime* m_time;
+    double m_startWallSeconds;
+    double m_startCPUSeconds;
+};
+
+    /// Add the counts of the function definitions in the module
+void addModuleCounts(const llvm::Module& module, SlangLLVMModuleCounts& ioCounts);
+
+    /// Add the metrics of a translation unit to those of the compilation. The total time isn't added, as how the
+    /// unit's time contributes depends on the thread it was compiled on.
+void addUnitMetrics(const SlangLLVMCompileMetrics& unitMetrics, SlangLLVMCompileMetrics& ioMetrics);
+
+/* The values of LLVM's statistics at a point in time.
+
+LLVM's statistics are process wide, so the change between two snapshots includes anything else the process did in
+the meantime, such as other compilations on other threads. Statistics are identified by name alone, so statistics with
+the same name from different passes are combined. */
+class StatisticsSnapshot
+{
+public:
+    typedef std::vector<std::pair<std::string, uint64_t>> Values;
+
+    void capture();
+
+        /// The statistics that changed since earlier, and by how much. Sorted by name.
+    Values getChangesSince(const StatisticsSnapshot& earlier) const;
+
+protected:
+    std::map<std::string, uint64_t> m_values;
+};
+
+class CompileMetrics : public ISlangLLVMCompileMetrics, public ComBaseObject
+{
+public:
+    // ISlangUnknown
+    SLANG_COM_BASE_IUNKNOWN_ALL
+
+    // ICastable
+    virtual SLANG_NO_THROW void* SLANG_MCALL castAs(const Guid& guid) SLANG_OVERRIDE;
+
+    // ISlangLLVMCompileMetrics
+    virtual SLANG_NO_THROW const SlangLLVMCompileMetrics* SLANG_MCALL getMetrics() SLANG_OVERRIDE { return &m_metrics; }
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getStatisticCount() SLANG_OVERRIDE { return m_statistics.size(); }
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getStatisticName(size_t index) SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW uint64_t SLANG_MCALL getStatisticValue(size_t index) SLANG_OVERRIDE;
+
+    CompileMetrics(const SlangLLVMCompileMetrics& metrics, StatisticsSnapshot::Values&& statistics) :
+        m_metrics(metrics),
+        m_statistics(std::move(statistics))
+    {
+    }
+
+protected:
+    ISlangUnknown* getInterface(const Guid& guid);
+    void* getObject(const Guid& guid);
+
+    SlangLLVMCompileMetrics m_metrics;
+    StatisticsSnapshot::Values m_statistics;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,273 @@
+#include "slang-llvm-object-cache.h"
+
+#include "slang-llvm-target.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+// Files in the cache directory must have this prefix for pruneCache to consider them
+static const char kCacheFilePrefix[] = "llvmcache-";
+// Temporary files don't have kCacheFilePrefix, so pruneCache never removes a file that is being written
+static const char kTempFilePrefix[] = "slang-llvm-tmp-";
+
+// Modules with an identifier starting with this are stored
+static const char kModuleIdentifierPrefix[] = "slang-llvm-object-cache:";
+// Modules with an identifier starting with this are only captured
+static const char kCaptureIdentifierPrefix[] = "slang-llvm-object-capture:";
+
+/* static */std::string DiskObjectCache::calcKey(const std::string& compileKey)
+{
+    SHA1 sha1;
+
+    sha1.update(compileKey);
+    sha1.update(LLVM_VERSION_STRING);
+    sha1.update(LLVM_DEFAULT_TARGET_TRIPLE);
+
+    // The CPU and features determine the output
+    sha1.update(TargetCPU::get().getKey());
+
+    return toHex(sha1.final(), true);
+}
+
+/* static */std::string DiskObjectCache::getModuleIdentifier(const std::string& key, bool isStored)
+{
+    return (isStored ? kModuleIdentifierPrefix : kCaptureIdentifierPrefix) + key;
+}
+
+std::string DiskObjectCache::_getPath(const std::string& key)
+{
+    SmallString<256> path(m_directory);
+    sys::path::append(path, kCacheFilePrefix + key + ".o");
+    return path.str().str();
+}
+
+std::string DiskObjectCache::_getTempPathModel()
+{
+    SmallString<256> path(m_directory);
+    sys::path::append(path, std::string(kTempFilePrefix) + "%%%%%%%%%%%%.o");
+    return path.str().str();
+}
+
+bool DiskObjectCache::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_directory.empty();
+}
+
+SlangResult DiskObjectCache::setDirectory(const char* path, uint64_t maxSizeInBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (path == nullptr || path[0] == 0)
+    {
+        m_directory.clear();
+        m_maxSizeInBytes = 0;
+        return SLANG_OK;
+    }
+
+    if (sys::fs::create_directories(path))
+    {
+        return SLANG_FAIL;
+    }
+
+    m_directory = path;
+    m_maxSizeInBytes = maxSizeInBytes;
+    return SLANG_OK;
+}
+
+std::unique_ptr<MemoryBuffer> DiskObjectCache::load(const std::string& key)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_directory.empty())
+        {
+            return nullptr;
+        }
+        path = _getPath(key);
+    }
+
+    std::unique_ptr<MemoryBuffer> buffer;
+    if (auto bufferOrError = MemoryBuffer::getFile(path))
+    {
+        buffer = std::move(*bufferOrError);
+
+        // Check it looks like an object, to protect against a damaged file
+        const auto magic = identify_magic(buffer->getBuffer());
+        if (magic != file_magic::elf_relocatable &&
+            magic != file_magic::macho_object &&
+            magic != file_magic::coff_object)
+        {
+            buffer.reset();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!buffer)
+    {
+        m_stats.missCount++;
+        return nullptr;
+    }
+
+    m_stats.hitCount++;
+    m_stats.bytesRead += buffer->getBufferSize();
+    return buffer;
+}
+
+void DiskObjectCache::store(const std::string& key, MemoryBufferRef obj)
+{
+    std::string directory;
+    uint64_t maxSizeInBytes;
+    std::string path;
+    std::string tmpModel;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_directory.empty())
+        {
+            return;
+        }
+        directory = m_directory;
+        maxSizeInBytes = m_maxSizeInBytes;
+        path = _getPath(key);
+        tmpModel = _getTempPathModel();
+    }
+
+    // Write to a unique temporary, and then rename. As rename is atomic, other processes will either see
+    // the complete file or nothing.
+    bool success = false;
+    {
+        int fd;
+        SmallString<256> tmpPath;
+        if (!sys::fs::createUniqueFile(tmpModel, fd, tmpPath))
+        {
+            {
+                raw_fd_ostream stream(fd, true);
+                stream << obj.getBuffer();
+                stream.close();
+                success = !stream.has_error();
+                if (!success)
+                {
+                    stream.clear_error();
+                }
+            }
+
+            success = success && !sys::fs::rename(tmpPath, path);
+            if (!success)
+            {
+                sys::fs::remove(tmpPath);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (success)
+        {
+            m_stats.writeCount++;
+            m_stats.bytesWritten += obj.getBufferSize();
+        }
+        else
+        {
+            m_stats.writeFailureCount++;
+        }
+    }
+
+    if (success)
+    {
+        _prune(directory, maxSizeInBytes);
+    }
+}
+
+/* static */void DiskObjectCache::_prune(const std::string& directory, uint64_t maxSizeInBytes)
+{
+    // Uses a timestamp file in the directory, so the directory is only scanned every prune interval
+    CachePruningPolicy policy;
+    policy.MaxSizeBytes = maxSizeInBytes;
+    pruneCache(directory, policy);
+}
+
+void DiskObjectCache::captureObject(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // If already being captured (by another compilation of the same source), the same object will be produced
+    m_capturedObjects.emplace(key, nullptr);
+}
+
+std::unique_ptr<MemoryBuffer> DiskObjectCache::takeCapturedObject(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_capturedObjects.find(key);
+    if (it == m_capturedObjects.end())
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<MemoryBuffer> object = std::move(it->second);
+    m_capturedObjects.erase(it);
+    return object;
+}
+
+void DiskObjectCache::notifyObjectCompiled(const Module* module, MemoryBufferRef obj)
+{
+    StringRef identifier = module->getModuleIdentifier();
+    if (identifier.consume_front(kModuleIdentifierPrefix))
+    {
+        store(identifier.str(), obj);
+    }
+    else if (!identifier.consume_front(kCaptureIdentifierPrefix))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_capturedObjects.find(identifier.str());
+    if (it != m_capturedObjects.end() && !it->second)
+    {
+        it->second = MemoryBuffer::getMemBufferCopy(obj.getBuffer(), obj.getBufferIdentifier());
+    }
+}
+
+std::unique_ptr<MemoryBuffer> DiskObjectCache::getObject(const Module* module)
+{
+    // Lookup is performed with load, before the frontend is run, so there is nothing to do here.
+    SLANG_UNUSED(module);
+    return nullptr;
+}
+
+void DiskObjectCache::getStats(SlangLLVMObjectCacheStats& outStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    outStats = m_stats;
+}
+
+/* static */DiskObjectCache& DiskObjectCache::getSingleton()
+{
+    static DiskObjectCache cache;
+    return cache;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMObjectCacheDirectory(const char* path, uint64_t maxSizeInBytes)
+{
+    return slang_llvm::DiskObjectCache::getSingleton().setDirectory(path, maxSizeInBytes);
+}
+
+extern "C" SLANG_DLL_EXPORT void getLLVMObjectCacheStats(SlangLLVMObjectCacheStats* outStats)
+{
+    slang_llvm::DiskObjectCache::getSingleton().getStats(*outStats);
+}
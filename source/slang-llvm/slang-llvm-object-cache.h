@@ -0,0 +1,80 @@
+#ifndef SLANG_LLVM_OBJECT_CACHE_H
+#define SLANG_LLVM_OBJECT_CACHE_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace slang_llvm {
+
+/* A process wide, optional, on disk cache of the object files produced by the JIT.
+
+The key is a hash of the compile key (as produced by CompileCache::calcKey), the LLVM version and the
+target CPU, so objects produced by a different version or for a different CPU are never loaded.
+
+Objects are stored by the JIT via the llvm::ObjectCache interface. Only modules whose identifier was produced
+by getModuleIdentifier are stored. Lookup is performed by key before running the frontend, so a hit skips both
+the frontend and code generation.
+
+Writes are to a unique temporary file which is then renamed, so multiple processes can share a directory.
+
+As every object the JIT produces passes through here, objects can also be captured (whether or not the directory is
+set). This is how the in memory CompileCache gets the object code of a compilation. */
+class DiskObjectCache : public llvm::ObjectCache
+{
+public:
+    // llvm::ObjectCache
+    virtual void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef obj) override;
+    virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+        /// Calculate the key for an object from the compile key
+    static std::string calcKey(const std::string& compileKey);
+        /// The module identifier to use such that the object produced for the module is stored with the key. If
+        /// isStored is false the object is only captured (see captureObject).
+    static std::string getModuleIdentifier(const std::string& key, bool isStored = true);
+
+        /// Load the object for the key. Returns nullptr if not found or not enabled.
+    std::unique_ptr<llvm::MemoryBuffer> load(const std::string& key);
+        /// Store the object for the key
+    void store(const std::string& key, llvm::MemoryBufferRef obj);
+
+        /// Hold on to a copy of the next object produced for the key, until it's taken with takeCapturedObject
+    void captureObject(const std::string& key);
+        /// Take the object captured for the key, ending the capture. Returns nullptr if no object was produced.
+    std::unique_ptr<llvm::MemoryBuffer> takeCapturedObject(const std::string& key);
+
+        /// Set the directory. An empty path disables the cache.
+    SlangResult setDirectory(const char* path, uint64_t maxSizeInBytes);
+        /// True if there is a directory set
+    bool isEnabled();
+
+    void getStats(SlangLLVMObjectCacheStats& outStats);
+
+        /// Get the process wide cache
+    static DiskObjectCache& getSingleton();
+
+protected:
+    std::string _getPath(const std::string& key);
+        /// The model for createUniqueFile of a temporary file in the directory
+    std::string _getTempPathModel();
+    static void _prune(const std::string& directory, uint64_t maxSizeInBytes);
+
+    std::mutex m_mutex;
+
+    std::string m_directory;
+    uint64_t m_maxSizeInBytes = 0;
+
+    SlangLLVMObjectCacheStats m_stats = {};
+
+        /// Keys being captured. The object is nullptr until it's produced.
+    std::unordered_map<std::string, std::unique_ptr<llvm::MemoryBuffer>> m_capturedObjects;
+};
+
+} // namespace slang_llvm
+
+#endif
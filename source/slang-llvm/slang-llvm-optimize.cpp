@@ -0,0 +1,362 @@
+#include "slang-llvm-optimize.h"
+
+#include "slang-llvm-target.h"
+#include "slang-llvm-vector-math.h"
+
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+
+#include <compiler-core/slang-slice-allocator.h>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+/* static */OptimizationProfile OptimizationProfile::getForLevel(int optLevel, int sizeLevel)
+{
+    OptimizationProfile profile;
+
+    // As with clang, optimizing for size implies -O2
+    profile.sizeLevel = sizeLevel;
+    profile.optLevel = (sizeLevel > 0) ? 2 : optLevel;
+
+    // Vectorization and unrolling are enabled from -O2, but minimal size (-Oz) disables them as they grow code
+    const bool isFull = profile.optLevel >= 2 && profile.sizeLevel < 2;
+
+    profile.vectorizeLoops = isFull;
+    profile.vectorizeSLP = isFull;
+    profile.unrollLoops = isFull;
+
+    return profile;
+}
+
+/* static */OptimizationProfile OptimizationProfile::getForLevel(DownstreamCompileOptions::OptimizationLevel level)
+{
+    typedef DownstreamCompileOptions::OptimizationLevel OptimizationLevel;
+    switch (level)
+    {
+        case OptimizationLevel::None:     return getForLevel(0, 0);
+        default:
+        case OptimizationLevel::Default:  return getForLevel(1, 0);
+        case OptimizationLevel::High:     return getForLevel(2, 0);
+        case OptimizationLevel::Maximal:  return getForLevel(3, 0);
+    }
+}
+
+static void _addDiagnostic(ArtifactDiagnostic::Severity severity, const std::string& text, IArtifactDiagnostics* diagnostics)
+{
+    ArtifactDiagnostic diagnostic;
+    diagnostic.severity = severity;
+    diagnostic.stage = ArtifactDiagnostic::Stage::Compile;
+    diagnostic.text = TerminatedCharSlice(text.c_str(), Count(text.size()));
+
+    diagnostics->add(diagnostic);
+}
+
+namespace { // anonymous
+
+// How a math runtime function is lowered
+enum class MathLowering
+{
+    Intrinsic,          ///< Call the intrinsic with the same semantics
+    FRem,               ///< The frem instruction, which has the semantics of fmod
+    IsNan,
+    IsInf,
+    IsFinite,
+};
+
+struct MathFunctionLowering
+{
+    const char* name;
+    MathLowering lowering;
+    Intrinsic::ID intrinsicId;
+};
+
+} // anonymous
+
+#define SLANG_LLVM_MATH_INTRINSICS(x) \
+    x(ceil, ceil) \
+    x(floor, floor) \
+    x(round, round) \
+    x(abs, fabs) \
+    x(fabs, fabs) \
+    x(trunc, trunc) \
+    x(sqrt, sqrt) \
+    x(sin, sin) \
+    x(cos, cos) \
+    x(exp, exp) \
+    x(exp2, exp2) \
+    x(log, log) \
+    x(log2, log2) \
+    x(log10, log10) \
+    x(pow, pow)
+
+#define SLANG_LLVM_MATH_INTRINSIC_LOWERING(name, intrinsic) \
+    { "F32_" #name, MathLowering::Intrinsic, Intrinsic::intrinsic }, \
+    { "F64_" #name, MathLowering::Intrinsic, Intrinsic::intrinsic },
+
+static const MathFunctionLowering kMathFunctionLowerings[] =
+{
+    SLANG_LLVM_MATH_INTRINSICS(SLANG_LLVM_MATH_INTRINSIC_LOWERING)
+
+    { "F32_fmod", MathLowering::FRem, Intrinsic::not_intrinsic },
+    { "F64_fmod", MathLowering::FRem, Intrinsic::not_intrinsic },
+    { "F32_isnan", MathLowering::IsNan, Intrinsic::not_intrinsic },
+    { "F64_isnan", MathLowering::IsNan, Intrinsic::not_intrinsic },
+    { "F32_isinf", MathLowering::IsInf, Intrinsic::not_intrinsic },
+    { "F64_isinf", MathLowering::IsInf, Intrinsic::not_intrinsic },
+    { "F32_isfinite", MathLowering::IsFinite, Intrinsic::not_intrinsic },
+    { "F64_isfinite", MathLowering::IsFinite, Intrinsic::not_intrinsic },
+};
+
+// Returns true if the function has the expected signature for the lowering
+static bool _canLower(const MathFunctionLowering& lowering, Function* func)
+{
+    FunctionType* funcType = func->getFunctionType();
+
+    Type* paramType = funcType->getNumParams() > 0 ? funcType->getParamType(0) : nullptr;
+    if (!paramType || !paramType->isFloatingPointTy())
+    {
+        return false;
+    }
+
+    switch (lowering.lowering)
+    {
+        case MathLowering::IsNan:
+        case MathLowering::IsInf:
+        case MathLowering::IsFinite:
+        {
+            return funcType->getNumParams() == 1 && funcType->getReturnType()->isIntegerTy(1);
+        }
+        default: break;
+    }
+
+    if (funcType->getReturnType() != paramType)
+    {
+        return false;
+    }
+    for (Type* type : funcType->params())
+    {
+        if (type != paramType)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Value* _lowerCall(const MathFunctionLowering& lowering, CallInst* call)
+{
+    IRBuilder<> builder(call);
+    Value* x = call->getArgOperand(0);
+
+    switch (lowering.lowering)
+    {
+        case MathLowering::Intrinsic:
+        {
+            SmallVector<Value*, 2> args(call->args());
+            return builder.CreateIntrinsic(lowering.intrinsicId, { x->getType() }, args);
+        }
+        case MathLowering::FRem:        return builder.CreateFRem(x, call->getArgOperand(1));
+        case MathLowering::IsNan:       return builder.CreateFCmpUNO(x, x);
+        case MathLowering::IsInf:
+        case MathLowering::IsFinite:
+        {
+            Value* absX = builder.CreateUnaryIntrinsic(Intrinsic::fabs, x);
+            Value* inf = ConstantFP::getInfinity(x->getType());
+            return (lowering.lowering == MathLowering::IsInf) ? builder.CreateFCmpOEQ(absX, inf) : builder.CreateFCmpONE(absX, inf);
+        }
+    }
+    return nullptr;
+}
+
+/* Calls to the math runtime functions (such as F32_floor) are to host functions, which the optimizer can't see
+into. Where there is an equivalent intrinsic or instruction we use that instead, so calls can be inlined, constant
+folded, vectorized, or become a single instruction. Intrinsics that become library calls are lowered to calls to
+the C library functions, which are available as host symbols. */
+static void _lowerMathCalls(llvm::Module& module)
+{
+    for (const auto& lowering : kMathFunctionLowerings)
+    {
+        Function* func = module.getFunction(lowering.name);
+        if (!func || !func->isDeclaration() || !_canLower(lowering, func))
+        {
+            continue;
+        }
+
+        SmallVector<CallInst*, 16> calls;
+        for (User* user : func->users())
+        {
+            auto call = dyn_cast<CallInst>(user);
+            if (call && call->getCalledFunction() == func)
+            {
+                calls.push_back(call);
+            }
+        }
+
+        for (CallInst* call : calls)
+        {
+            Value* value = _lowerCall(lowering, call);
+            call->replaceAllUsesWith(value);
+            call->eraseFromParent();
+        }
+
+        if (func->use_empty())
+        {
+            func->eraseFromParent();
+        }
+    }
+}
+
+static llvm::OptimizationLevel _getLLVMOptimizationLevel(const OptimizationProfile& profile)
+{
+    switch (profile.sizeLevel)
+    {
+        case 1:     return llvm::OptimizationLevel::Os;
+        case 2:     return llvm::OptimizationLevel::Oz;
+        default:    break;
+    }
+    switch (profile.optLevel)
+    {
+        case 0:     return llvm::OptimizationLevel::O0;
+        case 1:     return llvm::OptimizationLevel::O1;
+        case 2:     return llvm::OptimizationLevel::O2;
+        default:    return llvm::OptimizationLevel::O3;
+    }
+}
+
+// The name of the IR a pass is run on, for the time trace
+static std::string _getIRUnitName(Any ir)
+{
+    if (any_isa<const llvm::Module*>(ir))
+    {
+        return any_cast<const llvm::Module*>(ir)->getModuleIdentifier();
+    }
+    if (any_isa<const Function*>(ir))
+    {
+        return any_cast<const Function*>(ir)->getName().str();
+    }
+    return std::string();
+}
+
+// If the time trace profiler is enabled on this thread, add an event for each pass and analysis. (The legacy pass
+// manager used for code generation adds its own events.)
+static void _registerTimeTraceCallbacks(PassInstrumentationCallbacks& callbacks)
+{
+    if (!timeTraceProfilerEnabled())
+    {
+        return;
+    }
+
+    callbacks.registerBeforeNonSkippedPassCallback([](StringRef pass, Any ir) { timeTraceProfilerBegin(pass, [&]() { return _getIRUnitName(ir); }); });
+    callbacks.registerAfterPassCallback([](StringRef, Any, const PreservedAnalyses&) { timeTraceProfilerEnd(); });
+    callbacks.registerAfterPassInvalidatedCallback([](StringRef, const PreservedAnalyses&) { timeTraceProfilerEnd(); });
+    callbacks.registerBeforeAnalysisCallback([](StringRef pass, Any ir) { timeTraceProfilerBegin(pass, [&]() { return _getIRUnitName(ir); }); });
+    callbacks.registerAfterAnalysisCallback([](StringRef, Any) { timeTraceProfilerEnd(); });
+}
+
+SlangResult optimizeModule(const OptimizationProfile& profile, llvm::Module& module, IArtifactDiagnostics* diagnostics)
+{
+    TimeTraceScope timeScope("OptimizeModule", module.getModuleIdentifier());
+
+    // The target machine is needed so the vectorizers know the vector widths and costs of the target
+    auto jtmbExpected = TargetCPU::get().createJITTargetMachineBuilder();
+    if (!jtmbExpected)
+    {
+        _addDiagnostic(ArtifactDiagnostic::Severity::Error, "Unable to detect host: " + toString(jtmbExpected.takeError()), diagnostics);
+        diagnostics->setResult(SLANG_FAIL);
+        return SLANG_FAIL;
+    }
+    auto targetMachineExpected = jtmbExpected->createTargetMachine();
+    if (!targetMachineExpected)
+    {
+        _addDiagnostic(ArtifactDiagnostic::Severity::Error, "Unable to create target machine: " + toString(targetMachineExpected.takeError()), diagnostics);
+        diagnostics->setResult(SLANG_FAIL);
+        return SLANG_FAIL;
+    }
+    std::unique_ptr<TargetMachine> targetMachine = std::move(*targetMachineExpected);
+
+    // IR from elsewhere may not specify the target
+    if (module.getDataLayout().isDefault())
+    {
+        module.setDataLayout(targetMachine->createDataLayout());
+    }
+    if (module.getTargetTriple().empty())
+    {
+        module.setTargetTriple(targetMachine->getTargetTriple().str());
+    }
+
+    _lowerMathCalls(module);
+
+    PipelineTuningOptions tuning;
+    tuning.LoopVectorization = profile.vectorizeLoops;
+    tuning.SLPVectorization = profile.vectorizeSLP;
+    tuning.LoopUnrolling = profile.unrollLoops;
+    tuning.LoopInterleaving = profile.unrollLoops;
+
+#if LLVM_VERSION_MAJOR >= 15
+    if (profile.inlineThreshold >= 0)
+    {
+        tuning.InlinerThreshold = profile.inlineThreshold;
+    }
+#endif
+
+    LoopAnalysisManager loopAnalysisManager;
+    FunctionAnalysisManager functionAnalysisManager;
+    CGSCCAnalysisManager cgsccAnalysisManager;
+    ModuleAnalysisManager moduleAnalysisManager;
+
+    PassInstrumentationCallbacks instrumentationCallbacks;
+    _registerTimeTraceCallbacks(instrumentationCallbacks);
+
+    PassBuilder passBuilder(targetMachine.get(), tuning, None, &instrumentationCallbacks);
+
+    // Register the library info before the defaults, such that the vectorizer knows about the vector math functions
+    TargetLibraryInfoImpl libraryInfo(Triple(module.getTargetTriple()));
+    VectorMathLibrary::getSingleton().addVectorizableFunctions(libraryInfo);
+    functionAnalysisManager.registerPass([&] { return TargetLibraryAnalysis(libraryInfo); });
+
+    passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+    passBuilder.registerFunctionAnalyses(functionAnalysisManager);
+    passBuilder.registerLoopAnalyses(loopAnalysisManager);
+    passBuilder.crossRegisterProxies(loopAnalysisManager, functionAnalysisManager, cgsccAnalysisManager, moduleAnalysisManager);
+
+    const llvm::OptimizationLevel level = _getLLVMOptimizationLevel(profile);
+
+#if LLVM_VERSION_MAJOR < 15
+    // The default pipeline's inliner can't be given a threshold, so an inliner with the threshold runs after early
+    // simplification, just before the default inliner. The default inliner then runs with the level's threshold, so a
+    // threshold below it doesn't reduce inlining as much as it does with LLVM 15.
+    if (profile.inlineThreshold >= 0 && level != llvm::OptimizationLevel::O0)
+    {
+        const int inlineThreshold = profile.inlineThreshold;
+        passBuilder.registerPipelineEarlySimplificationEPCallback([inlineThreshold](ModulePassManager& modulePassManager, llvm::OptimizationLevel)
+        {
+            modulePassManager.addPass(ModuleInlinerWrapperPass(getInlineParams(inlineThreshold)));
+        });
+    }
+#endif
+
+    ModulePassManager modulePassManager = (level == llvm::OptimizationLevel::O0) ?
+        passBuilder.buildO0DefaultPipeline(level) :
+        passBuilder.buildPerModuleDefaultPipeline(level);
+
+    modulePassManager.run(module, moduleAnalysisManager);
+    return SLANG_OK;
+}
+
+} // namespace slang_llvm
@@ -0,0 +1,38 @@
+#ifndef SLANG_LLVM_OPTIMIZE_H
+#define SLANG_LLVM_OPTIMIZE_H
+
+#include <compiler-core/slang-downstream-compiler.h>
+#include <compiler-core/slang-artifact-associated.h>
+
+#include "llvm/IR/Module.h"
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* Controls the optimization pipeline that is run on a module before it is JIT'd (or otherwise output).
+
+The defaults for each level follow clang's, and individual knobs can then be overridden. */
+struct OptimizationProfile
+{
+        /// Get the default profile for the levels
+    static OptimizationProfile getForLevel(int optLevel, int sizeLevel);
+        /// Get the default profile for a DownstreamCompileOptions optimization level
+    static OptimizationProfile getForLevel(DownstreamCompileOptions::OptimizationLevel level);
+
+    int optLevel = 1;                       ///< 0 to 3, as -O0 to -O3
+    int sizeLevel = 0;                      ///< 0 for none, 1 for -Os, 2 for -Oz. optLevel is 2 if set.
+
+    bool vectorizeLoops = false;            ///< Enables the loop vectorizer
+    bool vectorizeSLP = false;              ///< Enables the SLP (straight line code) vectorizer
+    bool unrollLoops = false;               ///< Enables loop unrolling and interleaving
+    int inlineThreshold = -1;               ///< The inliner threshold. -1 uses the default for the levels.
+};
+
+/* Run the optimization pipeline for the profile on the module. The module should have been generated by clang
+with LLVM passes disabled (or be IR from elsewhere). Problems are reported to diagnostics. */
+SlangResult optimizeModule(const OptimizationProfile& profile, llvm::Module& module, IArtifactDiagnostics* diagnostics);
+
+} // namespace slang_llvm
+
+#endif
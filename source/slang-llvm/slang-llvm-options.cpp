@@ -0,0 +1,202 @@
+#include "slang-llvm-options.h"
+
+#include <core/slang-string.h>
+#include <core/slang-string-util.h>
+#include <compiler-core/slang-slice-allocator.h>
+
+namespace slang_llvm {
+
+static void _addArgError(const char* message, const UnownedStringSlice& arg, IArtifactDiagnostics* diagnostics, ArtifactDiagnostic::Severity severity = ArtifactDiagnostic::Severity::Error)
+{
+    StringBuilder buf;
+    buf << message << " '" << arg << "'";
+
+    ArtifactDiagnostic diagnostic;
+    diagnostic.severity = severity;
+    diagnostic.stage = ArtifactDiagnostic::Stage::Compile;
+    diagnostic.text = TerminatedCharSlice(buf.getBuffer(), buf.getLength());
+
+    diagnostics->add(diagnostic);
+    if (severity == ArtifactDiagnostic::Severity::Error)
+    {
+        diagnostics->setResult(SLANG_FAIL);
+    }
+}
+
+// Knob arguments are either "-name" to enable, or "-no-name" to disable. Returns true if the arg matched.
+static bool _parseFlag(const UnownedStringSlice& arg, const char* name, int& outValue)
+{
+    const UnownedStringSlice nameSlice(name);
+    if (arg.startsWith(UnownedStringSlice::fromLiteral("-no-")) && arg.tail(4) == nameSlice)
+    {
+        outValue = 0;
+        return true;
+    }
+    if (arg.startsWith(UnownedStringSlice::fromLiteral("-")) && arg.tail(1) == nameSlice)
+    {
+        outValue = 1;
+        return true;
+    }
+    return false;
+}
+
+/* static */bool LLVMCompileOptions::isPGOPhaseArg(const UnownedStringSlice& arg)
+{
+    return arg == UnownedStringSlice::fromLiteral("-jit-pgo-generate") || arg == UnownedStringSlice::fromLiteral("-jit-pgo-use");
+}
+
+SlangResult LLVMCompileOptions::parse(const DownstreamCompileOptions& options, IArtifactDiagnostics* diagnostics)
+{
+    const UnownedStringSlice inlineThresholdPrefix = UnownedStringSlice::fromLiteral("-inline-threshold=");
+    const UnownedStringSlice timeTraceGranularityPrefix = UnownedStringSlice::fromLiteral("-time-trace-granularity=");
+
+    // The level is taken from the options, unless overridden
+    int optLevel = -1;
+    int sizeLevel = 0;
+
+    // Knobs that have been explicitly set. -1 means not set.
+    int vectorizeLoops = -1;
+    int vectorizeSLP = -1;
+    int unrollLoops = -1;
+    int inlineThreshold = -1;
+
+    for (const auto& argSlice : options.compilerSpecificArguments)
+    {
+        const UnownedStringSlice arg = asStringSlice(argSlice);
+
+        if (arg == UnownedStringSlice::fromLiteral("-jit-lazy"))
+        {
+            lazy = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-tiered"))
+        {
+            tiered = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-frozen"))
+        {
+            frozen = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-counters"))
+        {
+            counters = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-cycle-counters"))
+        {
+            counters = true;
+            cycleCounters = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-pgo-generate"))
+        {
+            pgoGenerate = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-jit-pgo-use"))
+        {
+            pgoUse = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-llvm-stats"))
+        {
+            statistics = true;
+        }
+        else if (arg == UnownedStringSlice::fromLiteral("-time-trace"))
+        {
+            timeTrace = true;
+        }
+        else if (arg.startsWith(timeTraceGranularityPrefix))
+        {
+            Int value = 0;
+            if (SLANG_FAILED(StringUtil::parseInt(arg.tail(timeTraceGranularityPrefix.getLength()), value)) || value < 0)
+            {
+                _addArgError("Invalid slang-llvm time trace granularity", arg, diagnostics);
+                return SLANG_FAIL;
+            }
+            timeTraceGranularity = unsigned(value);
+        }
+        else if (arg.getLength() == 3 && arg.startsWith(UnownedStringSlice::fromLiteral("-O")))
+        {
+            const char c = arg[2];
+            if (c >= '0' && c <= '3')
+            {
+                optLevel = c - '0';
+                sizeLevel = 0;
+            }
+            else if (c == 's' || c == 'z')
+            {
+                optLevel = 2;
+                sizeLevel = (c == 's') ? 1 : 2;
+            }
+            else
+            {
+                _addArgError("Unknown slang-llvm optimization level", arg, diagnostics);
+                return SLANG_FAIL;
+            }
+        }
+        else if (_parseFlag(arg, "vectorize-loops", vectorizeLoops) ||
+            _parseFlag(arg, "vectorize-slp", vectorizeSLP) ||
+            _parseFlag(arg, "unroll-loops", unrollLoops))
+        {
+        }
+        else if (arg.startsWith(inlineThresholdPrefix))
+        {
+            Int value = 0;
+            if (SLANG_FAILED(StringUtil::parseInt(arg.tail(inlineThresholdPrefix.getLength()), value)) || value < 0)
+            {
+                _addArgError("Invalid slang-llvm inline threshold", arg, diagnostics);
+                return SLANG_FAIL;
+            }
+            inlineThreshold = int(value);
+        }
+        else
+        {
+            // Arguments may be meant for a different version of slang-llvm, so they are ignored
+            _addArgError("Ignoring unknown slang-llvm argument", arg, diagnostics, ArtifactDiagnostic::Severity::Warning);
+        }
+    }
+
+    // Tier 0 code is compiled eagerly so it can be replaced as a whole
+    if (lazy && tiered)
+    {
+        _addArgError("slang-llvm argument can't be used with -jit-lazy", UnownedStringSlice::fromLiteral("-jit-tiered"), diagnostics);
+        return SLANG_FAIL;
+    }
+    // Frozen symbols can't be compiled later, or redirected
+    if (frozen && (lazy || tiered))
+    {
+        _addArgError("slang-llvm argument can't be used with -jit-lazy or -jit-tiered", UnownedStringSlice::fromLiteral("-jit-frozen"), diagnostics);
+        return SLANG_FAIL;
+    }
+
+    // Tier 1 code would need to share the tier 0 counters
+    if (counters && tiered)
+    {
+        _addArgError("slang-llvm argument can't be used with -jit-tiered", UnownedStringSlice(cycleCounters ? "-jit-cycle-counters" : "-jit-counters"), diagnostics);
+        return SLANG_FAIL;
+    }
+
+    // A profile is either being collected or used. Tier 1 code would need to share the tier 0 counters.
+    if (pgoGenerate && (pgoUse || tiered))
+    {
+        _addArgError("slang-llvm argument can't be used with -jit-pgo-use or -jit-tiered", UnownedStringSlice::fromLiteral("-jit-pgo-generate"), diagnostics);
+        return SLANG_FAIL;
+    }
+
+    // Start with the defaults for the level, and then apply any knobs
+    profile = (optLevel >= 0) ? OptimizationProfile::getForLevel(optLevel, sizeLevel) : OptimizationProfile::getForLevel(options.optimizationLevel);
+
+    if (vectorizeLoops >= 0)
+    {
+        profile.vectorizeLoops = (vectorizeLoops != 0);
+    }
+    if (vectorizeSLP >= 0)
+    {
+        profile.vectorizeSLP = (vectorizeSLP != 0);
+    }
+    if (unrollLoops >= 0)
+    {
+        profile.unrollLoops = (unrollLoops != 0);
+    }
+    profile.inlineThreshold = inlineThreshold;
+
+    return SLANG_OK;
+}
+
+} // namespace slang_llvm
@@ -0,0 +1,55 @@
+#ifndef SLANG_LLVM_OPTIONS_H
+#define SLANG_LLVM_OPTIONS_H
+
+#include <compiler-core/slang-downstream-compiler.h>
+#include <compiler-core/slang-artifact-associated.h>
+
+#include "slang-llvm-optimize.h"
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* Options that are specific to slang-llvm.
+
+They are passed via DownstreamCompileOptions::compilerSpecificArguments, for example with `-Xllvm -jit-lazy`
+on the slangc command line. As the arguments are part of the compile cache key, different options produce
+different cache entries. */
+struct LLVMCompileOptions
+{
+        /// Parse the compiler specific arguments in options. Any problems are reported to diagnostics.
+    SlangResult parse(const DownstreamCompileOptions& options, IArtifactDiagnostics* diagnostics);
+        /// True if arg selects the phase of profile guided optimization. Profiles are keyed ignoring such args.
+    static bool isPGOPhaseArg(const UnownedStringSlice& arg);
+
+        /// If set, functions are only compiled when first looked up or called (-jit-lazy)
+    bool lazy = false;
+        /// If set, JIT'd code is first compiled without optimization, and replaced by code optimized with the
+        /// profile once it has been compiled in the background (-jit-tiered)
+    bool tiered = false;
+        /// If set, all exported symbols are materialized when the artifact is created, and then held by the artifact
+        /// rather than the JIT (-jit-frozen)
+    bool frozen = false;
+        /// If set, JIT'd functions count how often they are called (-jit-counters)
+    bool counters = false;
+        /// If set, JIT'd functions also count the cycles spent in them. Implies counters. (-jit-cycle-counters)
+    bool cycleCounters = false;
+        /// If set, JIT'd code collects a profile, for a later compilation with pgoUse (-jit-pgo-generate)
+    bool pgoGenerate = false;
+        /// If set, the profile collected with pgoGenerate is used to optimize (-jit-pgo-use)
+    bool pgoUse = false;
+        /// If set, the changes to LLVM's statistics during the compilation are included in its metrics (-llvm-stats)
+    bool statistics = false;
+        /// If set, a time trace of the compilation is associated with the artifact (-time-trace)
+    bool timeTrace = false;
+        /// The minimum duration of an event in the time trace, in microseconds (-time-trace-granularity=N)
+    unsigned timeTraceGranularity = 500;
+
+        /// The optimization pipeline. Defaults from options.optimizationLevel, and can be overridden with -O0 to -O3,
+        /// -Os, -Oz, -[no-]vectorize-loops, -[no-]vectorize-slp, -[no-]unroll-loops and -inline-threshold=N
+    OptimizationProfile profile;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,568 @@
+#include "slang-llvm-pgo.h"
+
+#include "slang-llvm-compile-cache.h"
+#include "slang-llvm-options.h"
+#include "slang-llvm-target.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <core/slang-string-util.h>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+static const char kProfileHeader[] = "slang-llvm-profile 1";
+static const char kProfileFilePrefix[] = "slang-llvm-profile-";
+
+// Functions that are instrumented, and so have a profile
+static bool _isProfiled(const Function& func)
+{
+    // Naked functions can only contain inline assembly. Available externally functions are only used for inlining.
+    return !func.isDeclaration() && !func.hasFnAttribute(Attribute::Naked) && !func.hasAvailableExternallyLinkage();
+}
+
+// The terminators with a choice of successor, in block order
+static void _getBranches(Function& func, std::vector<Instruction*>& outBranches)
+{
+    for (auto& block : func)
+    {
+        Instruction* terminator = block.getTerminator();
+        if (auto branch = dyn_cast<BranchInst>(terminator))
+        {
+            if (branch->isConditional())
+            {
+                outBranches.push_back(branch);
+            }
+        }
+        else if (isa<SwitchInst>(terminator))
+        {
+            outBranches.push_back(terminator);
+        }
+    }
+}
+
+// A hash of the shape of the CFG. Uses FNV-1a rather than hash_combine, as it's stored, so must be stable across
+// processes.
+static uint64_t _calcCFGHash(const Function& func)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto addValue = [&](uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    addValue(func.size());
+    for (const auto& block : func)
+    {
+        addValue(block.getTerminator()->getNumSuccessors());
+    }
+    return hash;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! PGOModuleProfile !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void PGOModuleProfile::merge(const PGOModuleProfile& other)
+{
+    for (const auto& pair : other.functions)
+    {
+        auto& function = functions[pair.first];
+        const auto& otherFunction = pair.second;
+
+        if (function.cfgHash != otherFunction.cfgHash || function.counts.size() != otherFunction.counts.size())
+        {
+            function = otherFunction;
+            continue;
+        }
+
+        for (size_t i = 0; i < function.counts.size(); ++i)
+        {
+            function.counts[i] = SaturatingAdd(function.counts[i], otherFunction.counts[i]);
+        }
+    }
+}
+
+void PGOModuleProfile::write(std::string& out) const
+{
+    // A line per function: name, CFG hash, count of counts, counts
+    raw_string_ostream stream(out);
+    stream << kProfileHeader << "\n";
+    for (const auto& pair : functions)
+    {
+        const auto& function = pair.second;
+        stream << pair.first << " " << format_hex_no_prefix(function.cfgHash, 16) << " " << function.counts.size();
+        for (uint64_t count : function.counts)
+        {
+            stream << " " << count;
+        }
+        stream << "\n";
+    }
+}
+
+bool PGOModuleProfile::read(StringRef text)
+{
+    functions.clear();
+
+    SmallVector<StringRef, 64> lines;
+    text.split(lines, '\n', -1, false);
+    if (lines.empty() || lines[0].trim() != kProfileHeader)
+    {
+        return false;
+    }
+
+    SmallVector<StringRef, 64> fields;
+    for (size_t i = 1; i < lines.size(); ++i)
+    {
+        fields.clear();
+        lines[i].trim().split(fields, ' ', -1, false);
+
+        PGOFunctionProfile function;
+        size_t countCount = 0;
+        if (fields.size() < 3 ||
+            fields[1].getAsInteger(16, function.cfgHash) ||
+            fields[2].getAsInteger(10, countCount) ||
+            fields.size() != countCount + 3)
+        {
+            return false;
+        }
+
+        function.counts.resize(countCount);
+        for (size_t j = 0; j < countCount; ++j)
+        {
+            if (fields[j + 3].getAsInteger(10, function.counts[j]))
+            {
+                return false;
+            }
+        }
+
+        functions[fields[0].str()] = std::move(function);
+    }
+    return true;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! Instrumentation !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void instrumentModuleForPGO(Module& module, StringRef countersName, PGOCounterLayout& outLayout)
+{
+    outLayout = PGOCounterLayout();
+
+    std::vector<Function*> funcs;
+    for (auto& func : module)
+    {
+        if (_isProfiled(func))
+        {
+            funcs.push_back(&func);
+        }
+    }
+
+    if (funcs.empty())
+    {
+        return;
+    }
+
+    // Work out the layout first, as the size of the array is needed to declare it
+    std::vector<std::vector<Instruction*>> funcBranches(funcs.size());
+    for (size_t i = 0; i < funcs.size(); ++i)
+    {
+        Function* func = funcs[i];
+        _getBranches(*func, funcBranches[i]);
+
+        PGOCounterLayout::Function layoutFunction;
+        layoutFunction.name = func->getName().str();
+        layoutFunction.cfgHash = _calcCFGHash(*func);
+        layoutFunction.counterStart = outLayout.counterCount;
+        layoutFunction.counterCount = 1;
+        for (Instruction* branch : funcBranches[i])
+        {
+            layoutFunction.counterCount += branch->getNumSuccessors();
+        }
+
+        outLayout.counterCount += layoutFunction.counterCount;
+        outLayout.functions.push_back(layoutFunction);
+    }
+
+    LLVMContext& context = module.getContext();
+    Type* int64Type = Type::getInt64Ty(context);
+    ArrayType* arrayType = ArrayType::get(int64Type, outLayout.counterCount);
+
+    // Only declared, the JIT resolves it to memory held by the artifact
+    auto counters = new GlobalVariable(module, arrayType, false, GlobalValue::ExternalLinkage, nullptr, countersName);
+
+    // Counters aren't atomic (as with clang's -fprofile-generate), so concurrent updates can be lost. That is
+    // acceptable for a profile, and much cheaper.
+    auto increment = [&](Instruction* insertBefore, size_t index)
+    {
+        IRBuilder<> builder(insertBefore);
+        Constant* indices[] = { ConstantInt::get(int64Type, 0), ConstantInt::get(int64Type, index) };
+        Constant* counter = ConstantExpr::getInBoundsGetElementPtr(arrayType, counters, indices);
+
+        Value* count = builder.CreateLoad(int64Type, counter);
+        builder.CreateStore(builder.CreateAdd(count, ConstantInt::get(int64Type, 1)), counter);
+    };
+
+    for (size_t i = 0; i < funcs.size(); ++i)
+    {
+        Function* func = funcs[i];
+        size_t counterIndex = outLayout.functions[i].counterStart;
+
+        increment(&*func->getEntryBlock().getFirstInsertionPt(), counterIndex++);
+
+        // Count each edge at its destination. If the destination can be reached another way, the edge is split so it
+        // has a block of its own.
+        for (Instruction* branch : funcBranches[i])
+        {
+            BasicBlock* block = branch->getParent();
+            const unsigned successorCount = branch->getNumSuccessors();
+            for (unsigned j = 0; j < successorCount; ++j)
+            {
+                BasicBlock* successor = branch->getSuccessor(j);
+                if (successor->getSinglePredecessor() != block)
+                {
+                    // Only fails for destinations that can't be split, which a br or switch can't branch to
+                    successor = SplitCriticalEdge(branch, j);
+                }
+
+                if (successor)
+                {
+                    increment(&*successor->getFirstInsertionPt(), counterIndex);
+                }
+                counterIndex++;
+            }
+        }
+    }
+}
+
+size_t applyPGOProfileToModule(Module& module, const PGOModuleProfile& profile)
+{
+    LLVMContext& context = module.getContext();
+    MDBuilder mdBuilder(context);
+
+    InstrProfSummaryBuilder summaryBuilder(ProfileSummaryBuilder::DefaultCutoffs.vec());
+
+    size_t appliedCount = 0;
+
+    std::vector<Instruction*> branches;
+    std::vector<uint32_t> weights;
+    for (auto& func : module)
+    {
+        if (!_isProfiled(func))
+        {
+            continue;
+        }
+
+        auto it = profile.functions.find(func.getName().str());
+        if (it == profile.functions.end() || it->second.cfgHash != _calcCFGHash(func))
+        {
+            continue;
+        }
+
+        const auto& counts = it->second.counts;
+
+        branches.clear();
+        _getBranches(func, branches);
+
+        size_t expectedCount = 1;
+        for (Instruction* branch : branches)
+        {
+            expectedCount += branch->getNumSuccessors();
+        }
+        if (counts.size() != expectedCount)
+        {
+            continue;
+        }
+
+        // A function that was never entered has a count of 0, so is treated as cold
+        func.setEntryCount(Function::ProfileCount(counts[0], Function::PCT_Real));
+        summaryBuilder.addRecord(InstrProfRecord(counts));
+
+        size_t countIndex = 1;
+        for (Instruction* branch : branches)
+        {
+            const unsigned successorCount = branch->getNumSuccessors();
+
+            uint64_t maxCount = 0;
+            for (unsigned j = 0; j < successorCount; ++j)
+            {
+                maxCount = std::max(maxCount, counts[countIndex + j]);
+            }
+
+            // Weights are 32 bit, so scale large counts down
+            if (maxCount > 0)
+            {
+                const uint64_t scale = (maxCount / UINT32_MAX) + 1;
+
+                weights.clear();
+                for (unsigned j = 0; j < successorCount; ++j)
+                {
+                    weights.push_back(uint32_t(counts[countIndex + j] / scale));
+                }
+                branch->setMetadata(LLVMContext::MD_prof, mdBuilder.createBranchWeights(weights));
+            }
+            countIndex += successorCount;
+        }
+
+        appliedCount++;
+    }
+
+    // The summary determines what is hot or cold, which is used by the inliner and others
+    if (appliedCount)
+    {
+        module.setProfileSummary(summaryBuilder.getSummary()->getMD(context), ProfileSummary::PSK_Instr);
+    }
+    return appliedCount;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! PGOProfileStore !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+/* static */std::string PGOProfileStore::calcKey(const DownstreamCompileOptions& options, ISlangBlob* sourceBlob)
+{
+    SHA1 sha1;
+
+    sha1.update(CompileCache::calcKeyIgnoringArgs(options, StringUtil::getSlice(sourceBlob), &LLVMCompileOptions::isPGOPhaseArg));
+
+    // The IR can differ between LLVM versions and targets
+    sha1.update(LLVM_VERSION_STRING);
+    sha1.update(LLVM_DEFAULT_TARGET_TRIPLE);
+    sha1.update(TargetCPU::get().getKey());
+
+    return toHex(sha1.final(), true);
+}
+
+std::string PGOProfileStore::_getPath(const std::string& key)
+{
+    SmallString<256> path(m_directory);
+    sys::path::append(path, kProfileFilePrefix + key + ".txt");
+    return path.str().str();
+}
+
+/* static */std::shared_ptr<PGOModuleProfile> PGOProfileStore::_read(const std::string& path)
+{
+    auto bufferOrError = MemoryBuffer::getFile(path);
+    if (!bufferOrError)
+    {
+        return nullptr;
+    }
+
+    auto profile = std::make_shared<PGOModuleProfile>();
+    return profile->read((*bufferOrError)->getBuffer()) ? profile : nullptr;
+}
+
+/* static */SlangResult PGOProfileStore::_write(const std::string& path, const std::string& tmpModel, const PGOModuleProfile& profile)
+{
+    std::string text;
+    profile.write(text);
+
+    int fd;
+    SmallString<256> tmpPath;
+    if (sys::fs::createUniqueFile(tmpModel, fd, tmpPath))
+    {
+        return SLANG_FAIL;
+    }
+
+    bool success;
+    {
+        raw_fd_ostream stream(fd, true);
+        stream << text;
+        stream.close();
+        success = !stream.has_error();
+        if (!success)
+        {
+            stream.clear_error();
+        }
+    }
+
+    success = success && !sys::fs::rename(tmpPath, path);
+    if (!success)
+    {
+        sys::fs::remove(tmpPath);
+        return SLANG_FAIL;
+    }
+    return SLANG_OK;
+}
+
+SlangResult PGOProfileStore::add(const std::string& key, const PGOModuleProfile& profile)
+{
+    std::shared_ptr<PGOModuleProfile> merged;
+    std::string path;
+    std::string tmpModel;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_directory.empty())
+        {
+            path = _getPath(key);
+            tmpModel = _getPath("tmp-%%%%%%%%%%%%");
+        }
+
+        // Held profiles are immutable, as they can be in use by compilations, so merge into a copy
+        auto it = m_profiles.find(key);
+        if (it != m_profiles.end())
+        {
+            merged = std::make_shared<PGOModuleProfile>(*it->second);
+        }
+        else if (!path.empty())
+        {
+            merged = _read(path);
+        }
+
+        if (merged)
+        {
+            merged->merge(profile);
+        }
+        else
+        {
+            merged = std::make_shared<PGOModuleProfile>(profile);
+        }
+
+        merged->generation = ++m_generationCounter;
+        m_profiles[key] = merged;
+    }
+
+    return path.empty() ? SLANG_OK : _write(path, tmpModel, *merged);
+}
+
+std::shared_ptr<const PGOModuleProfile> PGOProfileStore::find(const std::string& key)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_profiles.find(key);
+        if (it != m_profiles.end())
+        {
+            return it->second;
+        }
+        if (m_directory.empty())
+        {
+            return nullptr;
+        }
+        path = _getPath(key);
+    }
+
+    auto profile = _read(path);
+    if (!profile)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // It could have been added by another thread whilst reading
+    auto& heldProfile = m_profiles[key];
+    if (!heldProfile)
+    {
+        profile->generation = ++m_generationCounter;
+        heldProfile = profile;
+    }
+    return heldProfile;
+}
+
+SlangResult PGOProfileStore::setDirectory(const char* path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (path == nullptr || path[0] == 0)
+    {
+        m_directory.clear();
+        return SLANG_OK;
+    }
+
+    if (sys::fs::create_directories(path))
+    {
+        return SLANG_FAIL;
+    }
+
+    m_directory = path;
+    return SLANG_OK;
+}
+
+void PGOProfileStore::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_profiles.clear();
+}
+
+/* static */PGOProfileStore& PGOProfileStore::getSingleton()
+{
+    static PGOProfileStore store;
+    return store;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! JITPGOCounters !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+void JITPGOCounters::init(std::vector<Unit>&& units)
+{
+    m_units = std::move(units);
+
+    size_t valueCount = 0;
+    m_unitStarts.clear();
+    for (const auto& unit : m_units)
+    {
+        m_unitStarts.push_back(valueCount);
+        valueCount += unit.layout.counterCount;
+    }
+
+    m_values.reset(new std::atomic<uint64_t>[valueCount]);
+    for (size_t i = 0; i < valueCount; ++i)
+    {
+        m_values[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+SlangResult JITPGOCounters::harvest(PGOProfileStore& store)
+{
+    SlangResult res = SLANG_OK;
+    for (size_t i = 0; i < m_units.size(); ++i)
+    {
+        const auto& unit = m_units[i];
+        std::atomic<uint64_t>* values = m_values.get() + m_unitStarts[i];
+
+        PGOModuleProfile profile;
+        for (const auto& layoutFunction : unit.layout.functions)
+        {
+            PGOFunctionProfile& function = profile.functions[layoutFunction.name];
+            function.cfgHash = layoutFunction.cfgHash;
+            function.counts.resize(layoutFunction.counterCount);
+            for (size_t j = 0; j < layoutFunction.counterCount; ++j)
+            {
+                function.counts[j] = values[layoutFunction.counterStart + j].exchange(0, std::memory_order_relaxed);
+            }
+        }
+
+        const SlangResult unitRes = store.add(unit.profileKey, profile);
+        res = SLANG_FAILED(unitRes) ? unitRes : res;
+    }
+    return res;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMProfileDirectory(const char* path)
+{
+    return slang_llvm::PGOProfileStore::getSingleton().setDirectory(path);
+}
+
+extern "C" SLANG_DLL_EXPORT void clearLLVMProfiles()
+{
+    slang_llvm::PGOProfileStore::getSingleton().clear();
+}
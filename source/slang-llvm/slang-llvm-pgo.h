@@ -0,0 +1,138 @@
+#ifndef SLANG_LLVM_PGO_H
+#define SLANG_LLVM_PGO_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* The profile of a function.
+
+counts[0] is the number of times the function was entered. It's followed by a count for each successor of each branch
+(a conditional br, or a switch), in block order. */
+struct PGOFunctionProfile
+{
+    uint64_t cfgHash = 0;               ///< Identifies the shape of the function's CFG, so a profile is only applied to the same function
+    std::vector<uint64_t> counts;
+};
+
+/* The profile of a translation unit. */
+struct PGOModuleProfile
+{
+        /// Add the counts of other. If a function's CFG has changed, its profile is replaced.
+    void merge(const PGOModuleProfile& other);
+
+        /// Write as text
+    void write(std::string& out) const;
+        /// Read from text produced by write. Returns false if the text isn't a profile.
+    bool read(llvm::StringRef text);
+
+    std::map<std::string, PGOFunctionProfile> functions;
+        /// Unique in the process to each version of a stored profile, so compilations with different profiles have
+        /// different compile cache keys
+    uint64_t generation = 0;
+};
+
+/* Where the counters of each function of an instrumented module are. */
+struct PGOCounterLayout
+{
+    struct Function
+    {
+        std::string name;
+        uint64_t cfgHash;
+        size_t counterStart;
+        size_t counterCount;
+    };
+
+    std::vector<Function> functions;
+    size_t counterCount = 0;
+};
+
+    /// Instrument every function defined in module to count entries and the successors taken by branches, as
+    /// described by PGOFunctionProfile. The counters are the array countersName (of 64 bit integers), which is
+    /// declared by the module, and resolved by the JIT to memory held by the artifact.
+    /// Must be applied to the module before it's optimized.
+void instrumentModuleForPGO(llvm::Module& module, llvm::StringRef countersName, PGOCounterLayout& outLayout);
+
+    /// Apply profile to module, before it's optimized, as function entry counts and branch weights. Returns the
+    /// number of functions the profile was applied to.
+size_t applyPGOProfileToModule(llvm::Module& module, const PGOModuleProfile& profile);
+
+/* A process wide store of profiles, keyed by the source and options of the translation unit they are for.
+
+Harvested profiles are merged with the profile already held. If a directory is set, profiles are also written to it
+(to a unique temporary file which is then renamed, as with the object cache), and read from it if not held. */
+class PGOProfileStore
+{
+public:
+        /// Calculate the key of the profile for a translation unit. The arguments that select the phase (-jit-pgo-generate
+        /// and -jit-pgo-use) are ignored, so both phases have the same key.
+    static std::string calcKey(const DownstreamCompileOptions& options, ISlangBlob* sourceBlob);
+
+        /// Merge profile into the profile for the key
+    SlangResult add(const std::string& key, const PGOModuleProfile& profile);
+        /// Returns nullptr if there is no profile for the key
+    std::shared_ptr<const PGOModuleProfile> find(const std::string& key);
+
+        /// Set the directory. nullptr (or an empty path) disables.
+    SlangResult setDirectory(const char* path);
+        /// Release the in memory profiles
+    void clear();
+
+        /// Get the process wide store
+    static PGOProfileStore& getSingleton();
+
+protected:
+        /// Must be called with m_mutex locked
+    std::string _getPath(const std::string& key);
+    static std::shared_ptr<PGOModuleProfile> _read(const std::string& path);
+    static SlangResult _write(const std::string& path, const std::string& tmpModel, const PGOModuleProfile& profile);
+
+    std::mutex m_mutex;
+    std::string m_directory;
+    std::unordered_map<std::string, std::shared_ptr<const PGOModuleProfile>> m_profiles;
+    uint64_t m_generationCounter = 0;
+};
+
+/* The counters of the translation units of an artifact compiled with -jit-pgo-generate. */
+class JITPGOCounters
+{
+public:
+    struct Unit
+    {
+        std::string profileKey;
+        PGOCounterLayout layout;
+    };
+
+        /// Allocates (zeroed) counters for each unit
+    void init(std::vector<Unit>&& units);
+
+    size_t getUnitCount() const { return m_units.size(); }
+    const Unit& getUnit(size_t index) const { return m_units[index]; }
+        /// The counters of a unit, for its JIT'd code to update
+    void* getUnitData(size_t index) { return m_values.get() + m_unitStarts[index]; }
+
+        /// Add the counts to the store, and reset them
+    SlangResult harvest(PGOProfileStore& store);
+
+protected:
+    std::vector<Unit> m_units;
+    std::vector<size_t> m_unitStarts;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_values;
+};
+
+} // namespace slang_llvm
+
+#endif
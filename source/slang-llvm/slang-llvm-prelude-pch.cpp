@@ -0,0 +1,175 @@
+#include "slang-llvm-prelude-pch.h"
+
+#include "slang-llvm-target.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+/* static */std::string PreludePCHCache::calcKey(const DownstreamCompileOptions& options, const OptimizationProfile& profile, StringRef prelude)
+{
+    SHA1 sha1;
+
+    auto addValue = [&](uint64_t value) { sha1.update(ArrayRef<uint8_t>((const uint8_t*)&value, sizeof(value))); };
+    // Prefix with the length, so that the concatenation of strings is unambiguous
+    auto addString = [&](StringRef text) { addValue(text.size()); sha1.update(text); };
+
+    addString(prelude);
+
+    // What _initInvocation sets from the options
+    addValue(uint64_t(options.sourceLanguage));
+    addValue(uint64_t(options.defines.count));
+    for (const auto& define : options.defines)
+    {
+        addString(StringRef(define.nameWithSig.begin(), define.nameWithSig.count));
+    }
+    addValue(uint64_t(options.includePaths.count));
+    for (const auto& includePath : options.includePaths)
+    {
+        addString(StringRef(includePath.begin(), includePath.count));
+    }
+    addValue(options.floatingPointMode == DownstreamCompileOptions::FloatingPointMode::Fast);
+
+    // The levels only change whether __OPTIMIZE__ and __OPTIMIZE_SIZE__ are defined
+    addValue(profile.optLevel > 0);
+    addValue(profile.sizeLevel > 0);
+
+    // As the PCH may be on disk, the version. Clang won't use a PCH built for a different target CPU.
+    addString(LLVM_VERSION_STRING);
+    addString(LLVM_DEFAULT_TARGET_TRIPLE);
+    addString(TargetCPU::get().getKey());
+
+    return toHex(sha1.final(), true);
+}
+
+SlangResult PreludePCHCache::findPCH(const DownstreamCompileOptions& options, const OptimizationProfile& profile, StringRef source, const BuildFunc& buildFunc, std::string& outPCHPath, size_t& outPreludeSize)
+{
+    std::string prelude;
+    std::string directory;
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_prelude.empty() || !source.startswith(m_prelude))
+        {
+            return SLANG_E_NOT_FOUND;
+        }
+
+        prelude = m_prelude;
+        directory = m_directory;
+
+        const std::string key = calcKey(options, profile, prelude);
+
+        auto& entryPtr = m_entryMap[key];
+        if (!entryPtr)
+        {
+            entryPtr = std::make_shared<Entry>();
+
+            if (!directory.empty())
+            {
+                SmallString<256> path(directory);
+                sys::path::append(path, "slang-prelude-" + key + ".pch");
+                entryPtr->path = path.str().str();
+            }
+        }
+        entry = entryPtr;
+    }
+
+    // Only one thread builds an entry, other threads wait on the entry for it to complete.
+    {
+        std::lock_guard<std::mutex> entryLock(entry->mutex);
+
+        if (!entry->isBuilt)
+        {
+            entry->isBuilt = true;
+
+            if (entry->path.empty())
+            {
+                // Create a temporary file that will be overwritten with the PCH
+                SmallString<256> path;
+                if (sys::fs::createTemporaryFile("slang-prelude", "pch", path))
+                {
+                    entry->result = SLANG_FAIL;
+                }
+                else
+                {
+                    entry->path = path.str().str();
+
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_temporaryPaths.push_back(entry->path);
+
+                    entry->result = buildFunc(options, profile, prelude, entry->path);
+                }
+            }
+            else if (!sys::fs::exists(entry->path))
+            {
+                // Clang writes to a temporary and renames, so other processes never see a partial PCH
+                entry->result = buildFunc(options, profile, prelude, entry->path);
+            }
+        }
+
+        if (SLANG_FAILED(entry->result))
+        {
+            return entry->result;
+        }
+
+        outPCHPath = entry->path;
+    }
+
+    outPreludeSize = prelude.size();
+    return SLANG_OK;
+}
+
+SlangResult PreludePCHCache::setPrelude(const char* prelude, const char* directory)
+{
+    if (directory && directory[0])
+    {
+        if (sys::fs::create_directories(directory))
+        {
+            return SLANG_FAIL;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_prelude = prelude ? prelude : "";
+    m_directory = directory ? directory : "";
+
+    // Entries are keyed on the prelude, but the directory may have changed
+    m_entryMap.clear();
+    return SLANG_OK;
+}
+
+void PreludePCHCache::_removeTemporaryFiles()
+{
+    for (const auto& path : m_temporaryPaths)
+    {
+        sys::fs::remove(path);
+    }
+    m_temporaryPaths.clear();
+}
+
+PreludePCHCache::~PreludePCHCache()
+{
+    _removeTemporaryFiles();
+}
+
+/* static */PreludePCHCache& PreludePCHCache::getSingleton()
+{
+    static PreludePCHCache cache;
+    return cache;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMPreludePCH(const char* prelude, const char* directory)
+{
+    return slang_llvm::PreludePCHCache::getSingleton().setPrelude(prelude, directory);
+}
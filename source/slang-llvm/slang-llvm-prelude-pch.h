@@ -0,0 +1,77 @@
+#ifndef SLANG_LLVM_PRELUDE_PCH_H
+#define SLANG_LLVM_PRELUDE_PCH_H
+
+#include "slang-llvm.h"
+#include "slang-llvm-optimize.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace slang_llvm {
+
+using namespace Slang;
+
+/* Manages precompiled headers (PCH) for a designated prelude.
+
+Slang prepends a (large) prelude to the source it generates. If a source starts with the designated prelude,
+the prelude can be removed from the source, and the PCH built from the prelude implicitly included instead.
+
+A PCH depends on the options used to build it, so a PCH is built for each combination of the options that change
+how the prelude is parsed - the language, defines, include paths, floating point mode and the macros the optimization
+levels define. Options that only affect optimization or the JIT share a PCH. PCHs are built on first use.
+
+If a directory is set the PCHs are stored there, and can be used by subsequent processes. Otherwise they are held
+in temporary files that are removed when the process exits. */
+class PreludePCHCache
+{
+public:
+    typedef std::function<SlangResult(const DownstreamCompileOptions& options, const OptimizationProfile& profile, llvm::StringRef prelude, const std::string& pchPath)> BuildFunc;
+
+        /// If source starts with the prelude, outputs the path to the PCH to use, and the size of the prelude.
+        /// If the PCH hasn't been built, it is built with buildFunc.
+        /// Returns SLANG_E_NOT_FOUND if the source doesn't start with the prelude.
+    SlangResult findPCH(const DownstreamCompileOptions& options, const OptimizationProfile& profile, llvm::StringRef source, const BuildFunc& buildFunc, std::string& outPCHPath, size_t& outPreludeSize);
+
+        /// Set the prelude. An empty prelude disables.
+    SlangResult setPrelude(const char* prelude, const char* directory);
+
+        /// Get the process wide cache
+    static PreludePCHCache& getSingleton();
+
+    ~PreludePCHCache();
+
+        /// Calculate the key for a PCH of the prelude. Only the options that change how the prelude is parsed are part of it.
+    static std::string calcKey(const DownstreamCompileOptions& options, const OptimizationProfile& profile, llvm::StringRef prelude);
+
+protected:
+    struct Entry
+    {
+        std::mutex mutex;
+        bool isBuilt = false;
+        SlangResult result = SLANG_OK;
+        std::string path;
+    };
+
+    void _removeTemporaryFiles();
+
+    std::mutex m_mutex;
+
+    std::string m_prelude;
+    std::string m_directory;
+
+    std::unordered_map<std::string, std::shared_ptr<Entry>> m_entryMap;
+        /// Temporary files that need to be removed
+    std::vector<std::string> m_temporaryPaths;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,61 @@
+#include "slang-llvm-symbol-table.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace slang_llvm {
+
+void SymbolTable::init(const std::vector<std::string>& names, void* const* addresses)
+{
+    std::vector<size_t> indices;
+    size_t namesSize = 0;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        if (addresses[i])
+        {
+            indices.push_back(i);
+            namesSize += names[i].size() + 1;
+        }
+    }
+
+    std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return names[a] < names[b]; });
+
+    m_entries.clear();
+    m_entries.reserve(indices.size());
+
+    m_names.clear();
+    m_names.reserve(namesSize);
+
+    for (size_t index : indices)
+    {
+        const std::string& name = names[index];
+
+        // Names are unique
+        if (!m_entries.empty() && name == getName(m_entries.size() - 1))
+        {
+            continue;
+        }
+
+        Entry entry;
+        entry.nameOffset = uint32_t(m_names.size());
+        entry.address = addresses[index];
+        m_entries.push_back(entry);
+
+        m_names.insert(m_names.end(), name.begin(), name.end());
+        m_names.push_back(0);
+    }
+}
+
+void* SymbolTable::find(const char* name) const
+{
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), name, [&](const Entry& entry, const char* value) { return ::strcmp(m_names.data() + entry.nameOffset, value) < 0; });
+
+    if (it != m_entries.end() && ::strcmp(m_names.data() + it->nameOffset, name) == 0)
+    {
+        return it->address;
+    }
+    return nullptr;
+}
+
+} // namespace slang_llvm
@@ -0,0 +1,45 @@
+#ifndef SLANG_LLVM_SYMBOL_TABLE_H
+#define SLANG_LLVM_SYMBOL_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* A compact, immutable map from (unmangled) symbol name to address.
+
+Names are held null terminated in a single buffer, and entries are sorted by name, so a lookup is a binary search.
+Used by frozen artifacts, whose symbols are no longer held by the JIT. */
+class SymbolTable
+{
+public:
+        /// Initialize from names and their addresses. Names with a nullptr address are skipped.
+    void init(const std::vector<std::string>& names, void* const* addresses);
+
+        /// Returns nullptr if not found
+    void* find(const char* name) const;
+
+    size_t getCount() const { return m_entries.size(); }
+    const char* getName(size_t index) const { return m_names.data() + m_entries[index].nameOffset; }
+    void* getAddress(size_t index) const { return m_entries[index].address; }
+
+        /// The approximate memory held by the table
+    size_t getSizeInBytes() const { return sizeof(*this) + m_entries.size() * sizeof(Entry) + m_names.size(); }
+
+protected:
+    struct Entry
+    {
+        uint32_t nameOffset;            ///< Offset into m_names
+        void* address;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<char> m_names;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,139 @@
+#include "slang-llvm-target.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Host.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+namespace { // anonymous
+
+struct TargetState
+{
+    std::mutex mutex;
+    TargetCPU target;
+    bool isOverridden = false;
+        /// Set once the target has been used, after which it can't be changed
+    bool isFixed = false;
+};
+
+} // anonymous
+
+static TargetState& _getTargetState()
+{
+    static TargetState state;
+    return state;
+}
+
+static void _getHostTarget(TargetCPU& outTarget)
+{
+    outTarget.name = sys::getHostCPUName().str();
+    outTarget.features.clear();
+
+    StringMap<bool> features;
+    if (sys::getHostCPUFeatures(features))
+    {
+        for (const auto& feature : features)
+        {
+            outTarget.features.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+        }
+    }
+    // Make order independent of the map
+    std::sort(outTarget.features.begin(), outTarget.features.end());
+}
+
+std::string TargetCPU::getKey() const
+{
+    std::string key = name;
+    key += ";";
+    for (const auto& feature : features)
+    {
+        key += feature;
+        key += ",";
+    }
+    return key;
+}
+
+Expected<orc::JITTargetMachineBuilder> TargetCPU::createJITTargetMachineBuilder() const
+{
+    auto jtmbExpected = orc::JITTargetMachineBuilder::detectHost();
+    if (jtmbExpected)
+    {
+        // Replace whatever was detected with the target
+        jtmbExpected->setCPU(name);
+        jtmbExpected->setFeatures("");
+        jtmbExpected->addFeatures(features);
+    }
+    return jtmbExpected;
+}
+
+/* static */const TargetCPU& TargetCPU::get()
+{
+    auto& state = _getTargetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    if (!state.isFixed)
+    {
+        state.isFixed = true;
+        if (!state.isOverridden)
+        {
+            _getHostTarget(state.target);
+        }
+    }
+    return state.target;
+}
+
+/* static */SlangResult TargetCPU::set(const char* name, const char* features)
+{
+    auto& state = _getTargetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    if (state.isFixed)
+    {
+        return SLANG_FAIL;
+    }
+
+    TargetCPU target;
+    if (name)
+    {
+        target.name = name;
+
+        SmallVector<StringRef, 16> featureSlices;
+        StringRef(features ? features : "").split(featureSlices, ',', -1, false);
+
+        for (auto featureSlice : featureSlices)
+        {
+            featureSlice = featureSlice.trim();
+            if (featureSlice.empty())
+            {
+                continue;
+            }
+
+            // Features must be explicitly enabled or disabled
+            if (!SubtargetFeatures::hasFlag(featureSlice))
+            {
+                return SLANG_E_INVALID_ARG;
+            }
+            target.features.push_back(featureSlice.str());
+        }
+        std::sort(target.features.begin(), target.features.end());
+    }
+
+    state.target = target;
+    state.isOverridden = (name != nullptr);
+
+    return SLANG_OK;
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMTargetCPU(const char* name, const char* features)
+{
+    return slang_llvm::TargetCPU::set(name, features);
+}
@@ -0,0 +1,40 @@
+#ifndef SLANG_LLVM_TARGET_H
+#define SLANG_LLVM_TARGET_H
+
+#include "slang-llvm.h"
+
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* The CPU (and its features) that code is generated for.
+
+By default this is the host CPU, with the features detected on the host. It can be overridden, for example so
+that the same code is produced across a fleet of machines that have different CPUs.
+
+The same target is used for clang (such that the IR is annotated with the CPU and features), and for the JIT's
+target machine. The target is fixed on first use, after which it can't be changed. */
+struct TargetCPU
+{
+        /// Get a string that identifies the target, for use in cache keys
+    std::string getKey() const;
+
+        /// Create a builder for a target machine for the CPU
+    llvm::Expected<llvm::orc::JITTargetMachineBuilder> createJITTargetMachineBuilder() const;
+
+        /// Get the process wide target CPU
+    static const TargetCPU& get();
+        /// Override the process wide target CPU. features is a comma separated list (such as "+avx2,-avx512f").
+        /// Passing nullptr as the name reverts to the host. Fails if the target is already in use.
+    static SlangResult set(const char* name, const char* features);
+
+    std::string name;                       ///< The CPU name, as used by LLVM (for example "skylake")
+    std::vector<std::string> features;      ///< Features in the form "+feature" or "-feature", sorted
+};
+
+} // namespace slang_llvm
+
+#endif
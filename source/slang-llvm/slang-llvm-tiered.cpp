@@ -0,0 +1,296 @@
+#include "slang-llvm-tiered.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <compiler-core/slang-artifact-associated-impl.h>
+
+namespace slang_llvm {
+
+using namespace llvm;
+using namespace llvm::orc;
+
+static bool _isMutableGlobalDefinition(const GlobalVariable& global)
+{
+    // Globals named llvm.* (such as llvm.global_ctors) are special, and never shared
+    return !global.isDeclaration() && !global.isConstant() && !global.getName().startswith("llvm.");
+}
+
+void prepareModuleForTiering(llvm::Module& module)
+{
+    // Used to make names unique across all the modules in the process
+    static std::atomic<uint64_t> uniqueCounter{0};
+
+    for (auto& global : module.globals())
+    {
+        if (!_isMutableGlobalDefinition(global))
+        {
+            continue;
+        }
+
+        // Tier 1 looks up the tier 0 definition by name, so it must be visible outside of the module. As it's now
+        // visible to the other modules of the artifact, it needs a unique name.
+        if (global.hasLocalLinkage())
+        {
+            global.setName(global.getName() + ".tiered." + Twine(++uniqueCounter));
+            global.setLinkage(GlobalValue::ExternalLinkage);
+        }
+        global.setVisibility(GlobalValue::DefaultVisibility);
+    }
+}
+
+void markModuleForTier0(llvm::Module& module)
+{
+    // optnone also makes code generation use the fast instruction selector. optnone requires noinline.
+    for (auto& func : module)
+    {
+        if (func.isDeclaration())
+        {
+            continue;
+        }
+        func.removeFnAttr(Attribute::AlwaysInline);
+        func.addFnAttr(Attribute::NoInline);
+        func.addFnAttr(Attribute::OptimizeNone);
+    }
+}
+
+// Turn a (prepared) copy of a module into a tier 1 module, before it is optimized
+static void _makeTier1Module(llvm::Module& module)
+{
+    // Static constructors and destructors have already been run in tier 0
+    for (const char* name : { "llvm.global_ctors", "llvm.global_dtors" })
+    {
+        if (auto global = module.getNamedGlobal(name))
+        {
+            global->eraseFromParent();
+        }
+    }
+
+    // Use the tier 0 definitions of the mutable globals. They are in a different JITDylib, so can't be assumed to be
+    // close by.
+    for (auto& global : module.globals())
+    {
+        if (_isMutableGlobalDefinition(global))
+        {
+            global.setInitializer(nullptr);
+            global.setComdat(nullptr);
+            global.setLinkage(GlobalValue::ExternalLinkage);
+            global.setDSOLocal(false);
+        }
+    }
+}
+
+/* static */Expected<std::shared_ptr<TieredCode>> TieredCode::create(std::shared_ptr<JITSession> session, JITDylib& tier0Dylib)
+{
+    // Stubs need the same target support as lazy compilation
+    if (!session->isLazySupported())
+    {
+        return make_error<StringError>("tiered compilation is not supported on this target", inconvertibleErrorCode());
+    }
+
+    auto stubsBuilder = createLocalIndirectStubsManagerBuilder(session->getJIT().getTargetTriple());
+    return std::shared_ptr<TieredCode>(new TieredCode(std::move(session), tier0Dylib, stubsBuilder()));
+}
+
+TieredCode::TieredCode(std::shared_ptr<JITSession> session, JITDylib& tier0Dylib, std::unique_ptr<IndirectStubsManager> stubs) :
+    m_session(std::move(session)),
+    m_tier0Dylib(&tier0Dylib),
+    m_stubs(std::move(stubs))
+{
+}
+
+TieredCode::~TieredCode()
+{
+    // The last reference may be held by a tier up task, which can be using tier 0 (tier 1 links against it), so both
+    // are released here rather than by the artifact. Tier 1 goes first, as it depends on tier 0.
+    for (JITDylib* dylib : { m_tier1Dylib, m_tier0Dylib })
+    {
+        if (!dylib)
+        {
+            continue;
+        }
+        if (auto err = m_session->removeArtifactDylib(*dylib))
+        {
+            m_session->getExecutionSession().reportError(std::move(err));
+        }
+    }
+}
+
+bool TieredCode::isTieredUp()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_isTieredUp;
+}
+
+void* TieredCode::findSymbol(const char* name)
+{
+    auto& jit = m_session->getJIT();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Functions that have been looked up before already have a stub
+    if (auto stub = m_stubs->findStub(name, false))
+    {
+        return jitTargetAddressToPointer<void*>(stub.getAddress());
+    }
+
+    auto symbolExpected = jit.lookup(*m_tier0Dylib, name);
+    if (!symbolExpected)
+    {
+        consumeError(symbolExpected.takeError());
+        return nullptr;
+    }
+
+    // Data is only defined in tier 0, so can be used directly
+    JITTargetAddress address = symbolExpected->getAddress();
+    if (!symbolExpected->getFlags().isCallable())
+    {
+        return jitTargetAddressToPointer<void*>(address);
+    }
+
+    if (m_isTieredUp)
+    {
+        auto tier1SymbolExpected = jit.lookup(*m_tier1Dylib, name);
+        if (tier1SymbolExpected)
+        {
+            address = tier1SymbolExpected->getAddress();
+        }
+        else
+        {
+            consumeError(tier1SymbolExpected.takeError());
+        }
+    }
+
+    if (auto err = m_stubs->createStub(name, address, JITSymbolFlags::Exported | JITSymbolFlags::Callable))
+    {
+        // Without a stub the function can still be called, it just won't be redirected
+        consumeError(std::move(err));
+        return jitTargetAddressToPointer<void*>(address);
+    }
+    m_stubNames.push_back(name);
+
+    return jitTargetAddressToPointer<void*>(m_stubs->findStub(name, false).getAddress());
+}
+
+void TieredCode::startTierUp(const OptimizationProfile& profile, std::vector<std::string>&& bitcodes)
+{
+    // Only hold a weak reference, so the task doesn't keep the artifact's code alive once it's released
+    std::weak_ptr<TieredCode> weakThis = shared_from_this();
+
+    auto bitcodesPtr = std::make_shared<std::vector<std::string>>(std::move(bitcodes));
+
+    JITSession::runInBackground([weakThis, profile, bitcodesPtr]()
+    {
+        if (auto tieredCode = weakThis.lock())
+        {
+            tieredCode->_tierUp(profile, *bitcodesPtr);
+        }
+    });
+}
+
+Error TieredCode::_addTier1Modules(const OptimizationProfile& profile, const std::vector<std::string>& bitcodes)
+{
+    auto dylibExpected = m_session->createArtifactDylib();
+    if (!dylibExpected)
+    {
+        return dylibExpected.takeError();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tier1Dylib = &*dylibExpected;
+    }
+
+    // Tier 1 code finds the mutable globals in tier 0
+    m_tier1Dylib->addToLinkOrder(*m_tier0Dylib);
+
+    for (const auto& bitcode : bitcodes)
+    {
+        auto context = std::make_unique<LLVMContext>();
+
+        auto moduleExpected = parseBitcodeFile(MemoryBufferRef(bitcode, "slang-llvm-tier1"), *context);
+        if (!moduleExpected)
+        {
+            return moduleExpected.takeError();
+        }
+        auto module = std::move(*moduleExpected);
+
+        _makeTier1Module(*module);
+
+        // The module compiled for tier 0, so there shouldn't be any problems
+        ComPtr<IArtifactDiagnostics> diagnostics(new ArtifactDiagnostics);
+        if (SLANG_FAILED(optimizeModule(profile, *module, diagnostics)))
+        {
+            return make_error<StringError>("tier 1 optimization failed", inconvertibleErrorCode());
+        }
+
+        if (auto err = m_session->getJIT().addIRModule(*m_tier1Dylib, ThreadSafeModule(std::move(module), std::move(context))))
+        {
+            return err;
+        }
+    }
+    return Error::success();
+}
+
+void TieredCode::_tierUp(const OptimizationProfile& profile, const std::vector<std::string>& bitcodes)
+{
+    if (m_isAbandoned)
+    {
+        return;
+    }
+
+    auto& jit = m_session->getJIT();
+
+    // On failure we just stay on tier 0
+    if (auto err = _addTier1Modules(profile, bitcodes))
+    {
+        m_session->getExecutionSession().reportError(std::move(err));
+        return;
+    }
+
+    // Looking up the functions compiles them. Do this without the lock held, so finding symbols isn't blocked.
+    // Stubs created in the meantime are handled below.
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        names = m_stubNames;
+    }
+    for (const auto& name : names)
+    {
+        if (m_isAbandoned)
+        {
+            return;
+        }
+
+        auto symbolExpected = jit.lookup(*m_tier1Dylib, name);
+        if (!symbolExpected)
+        {
+            consumeError(symbolExpected.takeError());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A function may not be found if the optimizer removed it (say because it was unused), in which case its stub
+    // stays on tier 0. Updating the stubs pointer is a single pointer write, so calls switch over atomically.
+    for (const auto& name : m_stubNames)
+    {
+        auto symbolExpected = jit.lookup(*m_tier1Dylib, name);
+        if (!symbolExpected)
+        {
+            consumeError(symbolExpected.takeError());
+            continue;
+        }
+
+        if (auto err = m_stubs->updatePointer(name, symbolExpected->getAddress()))
+        {
+            consumeError(std::move(err));
+        }
+    }
+
+    m_isTieredUp = true;
+}
+
+} // namespace slang_llvm
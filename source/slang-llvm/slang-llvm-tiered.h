@@ -0,0 +1,84 @@
+#ifndef SLANG_LLVM_TIERED_H
+#define SLANG_LLVM_TIERED_H
+
+#include "slang-llvm-jit.h"
+#include "slang-llvm-optimize.h"
+
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/IR/Module.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* Tiered compilation of a JIT'd artifact (-jit-tiered).
+
+The artifact is first JIT'd without optimization (tier 0), which is fast, so the artifact can be returned immediately.
+The modules are then optimized with the requested profile and JIT'd again in the background (tier 1), into a separate
+JITDylib.
+
+Functions looked up via findSymbol are returned as indirection stubs. A stub initially jumps to the tier 0 function,
+and when tier 1 is ready the stub's pointer is updated to the tier 1 function. Callers don't need to look symbols up
+again, calls through previously returned addresses switch over to the optimized code.
+
+Data is only defined once, in tier 0. Tier 1 modules reference the tier 0 definitions of mutable globals, such that
+state is shared however code is reached. For this to work modules must be prepared with prepareModuleForTiering
+before they are copied for tier 1. */
+class TieredCode : public std::enable_shared_from_this<TieredCode>
+{
+public:
+        /// Create for an artifact whose tier 0 code is (or will be) in tier0Dylib. Takes ownership of tier0Dylib, which is
+        /// removed from the session along with tier 1 when the TieredCode is destroyed.
+    static llvm::Expected<std::shared_ptr<TieredCode>> create(std::shared_ptr<JITSession> session, llvm::orc::JITDylib& tier0Dylib);
+
+        /// Get the address of a symbol. Functions are returned as stubs. Returns nullptr if not found.
+    void* findSymbol(const char* name);
+
+        /// Start producing tier 1 code in the background. Each bitcode is a module (in the same order as added
+        /// to tier 0) that has been prepared with prepareModuleForTiering, but not optimized.
+    void startTierUp(const OptimizationProfile& profile, std::vector<std::string>&& bitcodes);
+
+        /// Called when the artifact is released. If tier 1 code hasn't been produced yet, it won't be. A tier up that is
+        /// in progress holds a reference, so the code is only removed once it has stopped.
+    void abandon() { m_isAbandoned = true; }
+
+        /// True once calls have been redirected to tier 1 code
+    bool isTieredUp();
+
+    ~TieredCode();
+
+protected:
+    TieredCode(std::shared_ptr<JITSession> session, llvm::orc::JITDylib& tier0Dylib, std::unique_ptr<llvm::orc::IndirectStubsManager> stubs);
+
+    void _tierUp(const OptimizationProfile& profile, const std::vector<std::string>& bitcodes);
+    llvm::Error _addTier1Modules(const OptimizationProfile& profile, const std::vector<std::string>& bitcodes);
+
+    std::shared_ptr<JITSession> m_session;
+    llvm::orc::JITDylib* m_tier0Dylib;
+        /// Set once tier up has started
+    llvm::orc::JITDylib* m_tier1Dylib = nullptr;
+
+        /// Guards the stubs and the tier state
+    std::mutex m_mutex;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> m_stubs;
+        /// The names of all the stubs that have been created, such that they can be redirected
+    std::vector<std::string> m_stubNames;
+    bool m_isTieredUp = false;
+
+    std::atomic<bool> m_isAbandoned{false};
+};
+
+/// Prepare a module such that tier 0 and tier 1 copies of it can share its data. Must be called before the module is
+/// copied (for example written as bitcode) for tier 1.
+void prepareModuleForTiering(llvm::Module& module);
+
+/// Mark all the functions in the module such that they are compiled quickly without optimization, in tier 0.
+void markModuleForTier0(llvm::Module& module);
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,160 @@
+#include "slang-llvm-time-trace.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+static const char _processName[] = "slang-llvm";
+
+// Held while a trace is started
+static std::mutex _traceMutex;
+
+// Protects the directory
+static std::mutex _directoryMutex;
+static std::string _directory;
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! TimeTrace !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+SlangResult TimeTrace::start(unsigned granularityInMicroseconds, bool wait)
+{
+    if (m_isStarted || timeTraceProfilerEnabled())
+    {
+        return SLANG_FAIL;
+    }
+
+    std::unique_lock<std::mutex> lock(_traceMutex, std::defer_lock);
+    if (wait)
+    {
+        lock.lock();
+    }
+    else if (!lock.try_lock())
+    {
+        return SLANG_E_TIME_OUT;
+    }
+    m_lock = std::move(lock);
+
+    timeTraceProfilerInitialize(granularityInMicroseconds, _processName);
+
+    m_granularity = granularityInMicroseconds;
+    m_isStarted = true;
+    return SLANG_OK;
+}
+
+void TimeTrace::stop(std::string& outJSON)
+{
+    if (!m_isStarted)
+    {
+        return;
+    }
+
+    {
+        SmallString<0> json;
+        raw_svector_ostream stream(json);
+        timeTraceProfilerWrite(stream);
+
+        outJSON = json.str().str();
+    }
+
+    // Also releases the instances of the other threads
+    timeTraceProfilerCleanup();
+
+    m_isStarted = false;
+    m_lock.unlock();
+}
+
+TimeTrace::~TimeTrace()
+{
+    if (m_isStarted)
+    {
+        timeTraceProfilerCleanup();
+    }
+}
+
+/* static */SlangResult TimeTrace::setDirectory(const char* path)
+{
+    std::lock_guard<std::mutex> lock(_directoryMutex);
+
+    if (path == nullptr || path[0] == 0)
+    {
+        _directory.clear();
+        return SLANG_OK;
+    }
+
+    if (sys::fs::create_directories(path))
+    {
+        return SLANG_FAIL;
+    }
+
+    _directory = path;
+    return SLANG_OK;
+}
+
+/* static */bool TimeTrace::hasDirectory()
+{
+    std::lock_guard<std::mutex> lock(_directoryMutex);
+    return !_directory.empty();
+}
+
+/* static */SlangResult TimeTrace::writeToDirectory(const std::string& json)
+{
+    // Traces from the same process are distinguished by a counter
+    static std::atomic<uint64_t> traceCounter{0};
+
+    SmallString<256> path;
+    {
+        std::lock_guard<std::mutex> lock(_directoryMutex);
+        if (_directory.empty())
+        {
+            return SLANG_OK;
+        }
+        path = _directory;
+    }
+
+    sys::path::append(path, Twine(_processName) + "-" + Twine(uint64_t(sys::Process::getProcessId())) + "-" + Twine(++traceCounter) + ".time-trace.json");
+
+    std::error_code ec;
+    raw_fd_ostream stream(path, ec, sys::fs::OF_Text);
+    if (ec)
+    {
+        return SLANG_FAIL;
+    }
+    stream << json;
+    return stream.has_error() ? SLANG_FAIL : SLANG_OK;
+}
+
+/* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!! TimeTraceThreadScope !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
+
+TimeTraceThreadScope::TimeTraceThreadScope(const TimeTrace* trace)
+{
+    if (trace && trace->isStarted() && !timeTraceProfilerEnabled())
+    {
+        timeTraceProfilerInitialize(trace->getGranularity(), _processName);
+        m_isTracing = true;
+    }
+}
+
+TimeTraceThreadScope::~TimeTraceThreadScope()
+{
+    // Hands the thread's instance over, so it's written with the trace
+    if (m_isTracing)
+    {
+        timeTraceProfilerFinishThread();
+    }
+}
+
+} // namespace slang_llvm
+
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMTimeTraceDirectory(const char* path)
+{
+    return slang_llvm::TimeTrace::setDirectory(path);
+}
@@ -0,0 +1,61 @@
+#ifndef SLANG_LLVM_TIME_TRACE_H
+#define SLANG_LLVM_TIME_TRACE_H
+
+#include "slang-llvm.h"
+
+#include <mutex>
+#include <string>
+
+namespace slang_llvm {
+
+/* Records a trace of a compilation in Chrome's trace event format, using LLVM's time trace profiler (as used by
+clang's -ftime-trace). Clang adds events for headers, parsing, template instantiation and code generation, and LLVM
+for passes.
+
+The profiler has an instance per thread. The instances of other threads are only written along with the thread that
+started the trace once they have finished, and the list of finished instances is process wide. So only one compilation
+can be traced at a time - a started TimeTrace holds a process wide lock until it's stopped. */
+class TimeTrace
+{
+public:
+        /// Start tracing the current thread. Fails if the thread is already traced (say by the application). If another
+        /// compilation is being traced, waits for it to finish if wait is set, otherwise returns SLANG_E_TIME_OUT.
+    SlangResult start(unsigned granularityInMicroseconds, bool wait);
+        /// Stop tracing, outputting the trace as JSON. Must be called on the thread that started the trace.
+    void stop(std::string& outJSON);
+
+    bool isStarted() const { return m_isStarted; }
+    unsigned getGranularity() const { return m_granularity; }
+
+        /// Stops the trace if it's started, discarding it
+    ~TimeTrace();
+
+        /// Set the directory traces are written to, creating it if necessary. If set all compilations are traced.
+        /// nullptr disables.
+    static SlangResult setDirectory(const char* path);
+        /// True if a directory is set
+    static bool hasDirectory();
+        /// Write the trace to a uniquely named file in the directory, if set
+    static SlangResult writeToDirectory(const std::string& json);
+
+protected:
+    std::unique_lock<std::mutex> m_lock;
+    bool m_isStarted = false;
+    unsigned m_granularity = 0;
+};
+
+/* Traces the current thread for the lifetime of the scope, as part of a trace started on another thread. Does nothing
+if trace is nullptr or not started. */
+class TimeTraceThreadScope
+{
+public:
+    explicit TimeTraceThreadScope(const TimeTrace* trace);
+    ~TimeTraceThreadScope();
+
+protected:
+    bool m_isTracing = false;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -0,0 +1,171 @@
+#include "slang-llvm-vector-math.h"
+
+#include "slang-llvm-target.h"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TypeSize.h"
+
+#include <algorithm>
+
+namespace slang_llvm {
+
+using namespace llvm;
+
+namespace { // anonymous
+
+struct ScalarFunction
+{
+    const char* scalarName;             ///< The name as called from JIT'd code
+    const char* intrinsicName;          ///< The intrinsic the function is lowered to, or nullptr if it isn't
+    const char* libName;                ///< The name of the function in the vector library
+    int paramCount;
+    bool isDouble;
+};
+
+// The libmvec variants for an ISA. Names are mangled according to the x86 vector function ABI, for example
+// _ZGVdN8v_sinf is the 8 wide AVX2 variant of sinf.
+struct VectorISA
+{
+    char isaChar;
+    const char* requiredFeature;        ///< Feature the target CPU must have, or nullptr if none is needed
+    unsigned floatWidth;
+    unsigned doubleWidth;
+};
+
+} // anonymous
+
+static const ScalarFunction kScalarFunctions[] =
+{
+    { "F32_sin", "llvm.sin.f32", "sinf", 1, false },
+    { "F32_cos", "llvm.cos.f32", "cosf", 1, false },
+    { "F32_tan", nullptr, "tanf", 1, false },
+    { "F32_asin", nullptr, "asinf", 1, false },
+    { "F32_acos", nullptr, "acosf", 1, false },
+    { "F32_atan", nullptr, "atanf", 1, false },
+    { "F32_sinh", nullptr, "sinhf", 1, false },
+    { "F32_cosh", nullptr, "coshf", 1, false },
+    { "F32_tanh", nullptr, "tanhf", 1, false },
+    { "F32_log", "llvm.log.f32", "logf", 1, false },
+    { "F32_log2", "llvm.log2.f32", "log2f", 1, false },
+    { "F32_log10", "llvm.log10.f32", "log10f", 1, false },
+    { "F32_exp", "llvm.exp.f32", "expf", 1, false },
+    { "F32_exp2", "llvm.exp2.f32", "exp2f", 1, false },
+    { "F32_pow", "llvm.pow.f32", "powf", 2, false },
+    { "F32_atan2", nullptr, "atan2f", 2, false },
+
+    { "F64_sin", "llvm.sin.f64", "sin", 1, true },
+    { "F64_cos", "llvm.cos.f64", "cos", 1, true },
+    { "F64_tan", nullptr, "tan", 1, true },
+    { "F64_asin", nullptr, "asin", 1, true },
+    { "F64_acos", nullptr, "acos", 1, true },
+    { "F64_atan", nullptr, "atan", 1, true },
+    { "F64_sinh", nullptr, "sinh", 1, true },
+    { "F64_cosh", nullptr, "cosh", 1, true },
+    { "F64_tanh", nullptr, "tanh", 1, true },
+    { "F64_log", "llvm.log.f64", "log", 1, true },
+    { "F64_log2", "llvm.log2.f64", "log2", 1, true },
+    { "F64_log10", "llvm.log10.f64", "log10", 1, true },
+    { "F64_exp", "llvm.exp.f64", "exp", 1, true },
+    { "F64_exp2", "llvm.exp2.f64", "exp2", 1, true },
+    { "F64_pow", "llvm.pow.f64", "pow", 2, true },
+    { "F64_atan2", nullptr, "atan2", 2, true },
+};
+
+// In order of preference. There is only one variant per width, so AVX2 is preferred over AVX for 8 wide float.
+static const VectorISA kVectorISAs[] =
+{
+    { 'e', "+avx512f", 16, 8 },
+    { 'd', "+avx2", 8, 4 },
+    { 'c', "+avx", 8, 4 },
+    { 'b', nullptr, 4, 2 },
+};
+
+void VectorMathLibrary::_init()
+{
+    const Triple triple(LLVM_DEFAULT_TARGET_TRIPLE);
+    if (triple.getArch() != Triple::x86_64 || !triple.isOSLinux())
+    {
+        return;
+    }
+
+    std::string errorString;
+    auto library = sys::DynamicLibrary::getPermanentLibrary("libmvec.so.1", &errorString);
+    if (!library.isValid())
+    {
+        return;
+    }
+
+    const auto& features = TargetCPU::get().features;
+
+    for (const auto& func : kScalarFunctions)
+    {
+        std::vector<unsigned> usedWidths;
+
+        for (const auto& isa : kVectorISAs)
+        {
+            if (isa.requiredFeature && std::find(features.begin(), features.end(), isa.requiredFeature) == features.end())
+            {
+                continue;
+            }
+
+            const unsigned width = func.isDouble ? isa.doubleWidth : isa.floatWidth;
+            if (std::find(usedWidths.begin(), usedWidths.end(), width) != usedWidths.end())
+            {
+                continue;
+            }
+
+            std::string vectorName = std::string("_ZGV") + isa.isaChar + "N" + std::to_string(width);
+            vectorName.append(size_t(func.paramCount), 'v');
+            vectorName += "_";
+            vectorName += func.libName;
+
+            // Not all versions of libmvec have all functions
+            void* address = library.getAddressOfSymbol(vectorName.c_str());
+            if (!address)
+            {
+                continue;
+            }
+
+            usedWidths.push_back(width);
+            m_entries.push_back(Entry{ func.scalarName, func.intrinsicName ? func.intrinsicName : "", vectorName, width, address });
+        }
+    }
+}
+
+void VectorMathLibrary::addVectorizableFunctions(TargetLibraryInfoImpl& tlii) const
+{
+    std::vector<VecDesc> descs;
+    for (const auto& entry : m_entries)
+    {
+        descs.push_back(VecDesc{ entry.scalarName, entry.vectorName, ElementCount::getFixed(entry.width) });
+
+        // Calls to the scalar function may have been lowered to the intrinsic
+        if (!entry.intrinsicName.empty())
+        {
+            descs.push_back(VecDesc{ entry.intrinsicName, entry.vectorName, ElementCount::getFixed(entry.width) });
+        }
+    }
+    tlii.addVectorizableFunctions(descs);
+}
+
+void VectorMathLibrary::getHostSymbols(std::vector<HostSymbol>& outSymbols) const
+{
+    for (const auto& entry : m_entries)
+    {
+        outSymbols.push_back(HostSymbol{ entry.vectorName.c_str(), entry.address });
+    }
+}
+
+/* static */const VectorMathLibrary& VectorMathLibrary::getSingleton()
+{
+    static const VectorMathLibrary library = []()
+    {
+        VectorMathLibrary lib;
+        lib._init();
+        return lib;
+    }();
+    return library;
+}
+
+} // namespace slang_llvm
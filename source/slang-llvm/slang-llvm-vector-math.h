@@ -0,0 +1,52 @@
+#ifndef SLANG_LLVM_VECTOR_MATH_H
+#define SLANG_LLVM_VECTOR_MATH_H
+
+#include "slang-llvm-jit.h"
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+
+#include <string>
+#include <vector>
+
+namespace slang_llvm {
+
+/* Vector variants of the math functions (such as F32_sin) that JIT'd code can call.
+
+The variants are added to the TargetLibraryInfo used by the optimization pipeline, so the loop vectorizer can
+replace a call to a scalar function in a loop with a call to a vector variant. The variants are made available to
+JIT'd code as host symbols.
+
+Currently the variants come from glibc's libmvec on x86_64 Linux. libmvec is loaded if available, and only the
+functions it provides, at the widths the target CPU supports (4/8/16 wide float, 2/4/8 wide double for SSE, AVX2,
+AVX-512), are used. On other platforms there are no variants, and such loops stay scalar. */
+class VectorMathLibrary
+{
+public:
+    struct Entry
+    {
+        std::string scalarName;         ///< The name of the scalar function, such as F32_sin
+        std::string intrinsicName;      ///< The intrinsic the scalar function is lowered to (if it is), such as llvm.sin.f32
+        std::string vectorName;         ///< The name of the vector variant
+        unsigned width;                 ///< The number of lanes
+        void* address;                  ///< The address of the vector variant
+    };
+
+        /// Add the variants to the TLI, such that the vectorizer can use them
+    void addVectorizableFunctions(llvm::TargetLibraryInfoImpl& tlii) const;
+        /// Add the variants as host symbols
+    void getHostSymbols(std::vector<HostSymbol>& outSymbols) const;
+
+    const std::vector<Entry>& getEntries() const { return m_entries; }
+
+        /// Get the process wide library. The variants are determined on first use, for the target CPU.
+    static const VectorMathLibrary& getSingleton();
+
+protected:
+    void _init();
+
+    std::vector<Entry> m_entries;
+};
+
+} // namespace slang_llvm
+
+#endif
@@ -1,4 +1,6 @@
 
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/DeclGroup.h"
 #include "clang/Basic/Stack.h"
 #include "clang/Basic/TargetOptions.h"
 #include "clang/CodeGen/ObjectFilePCHContainerOperations.h"
@@ -19,7 +21,9 @@
 #include "clang/CodeGen/CodeGenAction.h"
 #include "clang/Basic/Version.h"
 
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/LinkAllPasses.h"
 #include "llvm/Option/Arg.h"
@@ -34,6 +38,7 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 
@@ -52,8 +57,11 @@
 
 #include "llvm/ExecutionEngine/JITSymbol.h"
 
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/Object/ObjectFile.h"
 
 // Slang
 
@@ -61,6 +69,7 @@
 #include <slang-com-helper.h>
 #include <slang-com-ptr.h>
 
+#include <core/slang-blob.h>
 #include <core/slang-list.h>
 #include <core/slang-string.h>
 
@@ -74,8 +83,26 @@
 #include <compiler-core/slang-artifact-desc-util.h>
 #include <compiler-core/slang-slice-allocator.h>
 
+#include "slang-llvm-compile-cache.h"
+#include "slang-llvm-counters.h"
+#include "slang-llvm-jit.h"
+#include "slang-llvm-metrics.h"
+#include "slang-llvm-object-cache.h"
+#include "slang-llvm-optimize.h"
+#include "slang-llvm-options.h"
+#include "slang-llvm-pgo.h"
+#include "slang-llvm-prelude-pch.h"
+#include "slang-llvm-symbol-table.h"
+#include "slang-llvm-target.h"
+#include "slang-llvm-tiered.h"
+#include "slang-llvm-time-trace.h"
+#include "slang-llvm-vector-math.h"
+
 #include <stdio.h>
 
+#include <algorithm>
+#include <shared_mutex>
+
 // We want to make math functions available to the JIT
 #if SLANG_GCC_FAMILY && __GNUC__ < 6
 #   include <cmath>
@@ -155,8 +182,17 @@ public:
 /* !!!!!!!!!!!!!!!!!!!!! LLVMJITSharedLibrary !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
 
 /* This implementation uses atomic ref counting to ensure the shared libraries lifetime can outlive the 
-LLVMDownstreamCompileResult and the compilation that created it */
-class LLVMJITSharedLibrary : public ISlangSharedLibrary, public ComBaseObject
+LLVMDownstreamCompileResult and the compilation that created it.
+
+The library's code is held in its own JITDylib in the process wide JITSession. If the library is tiered, functions are
+found via the TieredCode, such that they are redirected to optimized code once it's available. If the library is
+frozen, its symbols are held in a SymbolTable, and the JIT is only holding its memory. If its functions are counted,
+it holds the counters, and also implements ISlangLLVMJITCounters. Similarly if it collects a profile, it implements
+ISlangLLVMJITProfile.
+
+Otherwise addresses that have been found are cached, so the JIT (which requires mangling, interning and a session
+wide lookup) is only used the first time a symbol is looked up. */
+class LLVMJITSharedLibrary : public ISlangLLVMJITSharedLibrary, public ISlangLLVMJITCounters, public ISlangLLVMJITProfile, public ComBaseObject
 {
 public:
     // ISlangUnknown
@@ -168,25 +204,102 @@ public:
     // ISlangSharedLibrary impl
     virtual SLANG_NO_THROW void* SLANG_MCALL findSymbolAddressByName(char const* name) SLANG_OVERRIDE;
 
-    LLVMJITSharedLibrary(std::unique_ptr<llvm::orc::LLJIT> jit) :
-        m_jit(std::move(jit))
+    // ISlangLLVMJITSharedLibrary impl
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL findSymbolAddressesByName(const char* const* names, size_t count, void** outAddresses) SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getExportedSymbolCount() SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getExportedSymbolName(size_t index) SLANG_OVERRIDE;
+
+    // ISlangLLVMJITCounters impl
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getFunctionCount() SLANG_OVERRIDE { return m_counters ? m_counters->getCount() : 0; }
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getFunctionName(size_t index) SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL getFunctionCounters(size_t index, SlangLLVMFunctionCounters* outCounters) SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL findFunctionCounters(const char* name, SlangLLVMFunctionCounters* outCounters) SLANG_OVERRIDE;
+    virtual SLANG_NO_THROW void SLANG_MCALL resetCounters() SLANG_OVERRIDE;
+
+    // ISlangLLVMJITProfile impl
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL harvestProfile() SLANG_OVERRIDE;
+
+    LLVMJITSharedLibrary(std::shared_ptr<JITSession> session, llvm::orc::JITDylib* dylib) :
+        m_session(std::move(session)),
+        m_dylib(dylib)
     {
     }
 
+    ~LLVMJITSharedLibrary();
+
+        /// Set if the library's code is compiled in tiers
+    void setTieredCode(std::shared_ptr<TieredCode> tieredCode) { m_tieredCode = std::move(tieredCode); }
+        /// Set once the library's symbols have been removed from the JIT
+    void setFrozenSymbols(std::unique_ptr<SymbolTable> symbols) { m_frozenSymbols = std::move(symbols); }
+        /// Set the (sorted) names of the symbols the library exports. Not needed if frozen.
+    void setExportedNames(std::vector<std::string>&& names) { m_exportedNames = std::move(names); }
+        /// Set if the library's functions are counted. Must be set before code using them is JIT'd.
+    void setCounters(std::unique_ptr<JITCounters> counters) { m_counters = std::move(counters); }
+        /// Set if the library's code collects a profile. Must be set before code using them is JIT'd.
+    void setPGOCounters(std::unique_ptr<JITPGOCounters> counters) { m_pgoCounters = std::move(counters); }
+
 protected:
     ISlangUnknown* getInterface(const SlangUUID& uuid);
     void* getObject(const SlangUUID& uuid);
 
-    std::unique_ptr<llvm::orc::LLJIT> m_jit;
+        /// Look up without using the cache
+    void* _findSymbolAddress(const char* name);
+
+        /// The session is shared between all libraries. Holding it keeps it alive for the lifetime of this library.
+    std::shared_ptr<JITSession> m_session;
+        /// The dylib that holds this libraries symbols. Removed from the session when the library is released.
+    llvm::orc::JITDylib* m_dylib;
+        /// If set, symbols are found through it
+    std::shared_ptr<TieredCode> m_tieredCode;
+        /// If set, symbols are found in it
+    std::unique_ptr<SymbolTable> m_frozenSymbols;
+
+    std::vector<std::string> m_exportedNames;
+
+        /// If set, the counters updated by the library's functions
+    std::unique_ptr<JITCounters> m_counters;
+        /// If set, the counters updated by the library's code to collect a profile
+    std::unique_ptr<JITPGOCounters> m_pgoCounters;
+
+        /// Addresses that have been found. Lookups can happen on multiple threads.
+    std::shared_mutex m_symbolCacheMutex;
+    llvm::StringMap<void*> m_symbolCache;
 };
 
+LLVMJITSharedLibrary::~LLVMJITSharedLibrary()
+{
+    // Tier 1 code uses our data, so stop it from being produced. The TieredCode owns our dylib, and releases it (along
+    // with tier 1) when the last reference to it is released, which may be held by a background task.
+    if (m_tieredCode)
+    {
+        m_tieredCode->abandon();
+        m_tieredCode.reset();
+        return;
+    }
+
+    // Release the code, data and symbols held in the JIT. Counters are released afterwards, with the members.
+    if (auto err = m_session->removeArtifactDylib(*m_dylib))
+    {
+        m_session->getExecutionSession().reportError(std::move(err));
+    }
+}
+
 ISlangUnknown* LLVMJITSharedLibrary::getInterface(const SlangUUID& guid)
 {
     if (guid == ISlangUnknown::getTypeGuid() || 
         guid == ISlangCastable::getTypeGuid() ||
-        guid == ISlangSharedLibrary::getTypeGuid())
+        guid == ISlangSharedLibrary::getTypeGuid() ||
+        guid == ISlangLLVMJITSharedLibrary::getTypeGuid())
+    {
+        return static_cast<ISlangLLVMJITSharedLibrary*>(this);
+    }
+    if (guid == ISlangLLVMJITCounters::getTypeGuid() && m_counters)
+    {
+        return static_cast<ISlangLLVMJITCounters*>(this);
+    }
+    if (guid == ISlangLLVMJITProfile::getTypeGuid() && m_pgoCounters)
     {
-        return static_cast<ISlangSharedLibrary*>(this);
+        return static_cast<ISlangLLVMJITProfile*>(this);
     }
     return nullptr;
 }
@@ -208,12 +321,177 @@ void* LLVMJITSharedLibrary::castAs(const Guid& guid)
 
 void* LLVMJITSharedLibrary::findSymbolAddressByName(char const* name)
 {
-    auto fnExpected = m_jit->lookup(name);
+    if (m_frozenSymbols)
+    {
+        return m_frozenSymbols->find(name);
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(m_symbolCacheMutex);
+        auto it = m_symbolCache.find(name);
+        if (it != m_symbolCache.end())
+        {
+            return it->second;
+        }
+    }
+
+    void* address = _findSymbolAddress(name);
+    if (address)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_symbolCacheMutex);
+        m_symbolCache.try_emplace(name, address);
+    }
+    return address;
+}
+
+SlangResult LLVMJITSharedLibrary::findSymbolAddressesByName(const char* const* names, size_t count, void** outAddresses)
+{
+    if (m_frozenSymbols)
+    {
+        SlangResult res = SLANG_OK;
+        for (size_t i = 0; i < count; ++i)
+        {
+            outAddresses[i] = m_frozenSymbols->find(names[i]);
+            res = outAddresses[i] ? res : SLANG_E_NOT_FOUND;
+        }
+        return res;
+    }
+
+    // Find what we can in the cache, and look up the rest
+    std::vector<size_t> missingIndices;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_symbolCacheMutex);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto it = m_symbolCache.find(names[i]);
+            if (it != m_symbolCache.end())
+            {
+                outAddresses[i] = it->second;
+            }
+            else
+            {
+                missingIndices.push_back(i);
+            }
+        }
+    }
+
+    if (missingIndices.empty())
+    {
+        return SLANG_OK;
+    }
+
+    if (m_tieredCode)
+    {
+        // Each function needs its own stub, so there is no advantage to a single query
+        for (size_t index : missingIndices)
+        {
+            outAddresses[index] = m_tieredCode->findSymbol(names[index]);
+        }
+    }
+    else
+    {
+        std::vector<const char*> missingNames;
+        for (size_t index : missingIndices)
+        {
+            missingNames.push_back(names[index]);
+        }
+
+        std::vector<void*> addresses(missingNames.size());
+        if (auto err = m_session->lookupSymbols(*m_dylib, missingNames.data(), missingNames.size(), addresses.data()))
+        {
+            consumeError(std::move(err));
+            for (size_t index : missingIndices)
+            {
+                outAddresses[index] = nullptr;
+            }
+            return SLANG_FAIL;
+        }
+
+        for (size_t i = 0; i < missingIndices.size(); ++i)
+        {
+            outAddresses[missingIndices[i]] = addresses[i];
+        }
+    }
+
+    SlangResult res = SLANG_OK;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_symbolCacheMutex);
+        for (size_t index : missingIndices)
+        {
+            if (outAddresses[index])
+            {
+                m_symbolCache.try_emplace(names[index], outAddresses[index]);
+            }
+            else
+            {
+                res = SLANG_E_NOT_FOUND;
+            }
+        }
+    }
+    return res;
+}
+
+size_t LLVMJITSharedLibrary::getExportedSymbolCount()
+{
+    return m_frozenSymbols ? m_frozenSymbols->getCount() : m_exportedNames.size();
+}
+
+const char* LLVMJITSharedLibrary::getExportedSymbolName(size_t index)
+{
+    if (m_frozenSymbols)
+    {
+        return (index < m_frozenSymbols->getCount()) ? m_frozenSymbols->getName(index) : nullptr;
+    }
+    return (index < m_exportedNames.size()) ? m_exportedNames[index].c_str() : nullptr;
+}
+
+const char* LLVMJITSharedLibrary::getFunctionName(size_t index)
+{
+    return (m_counters && index < m_counters->getCount()) ? m_counters->getName(index) : nullptr;
+}
+
+SlangResult LLVMJITSharedLibrary::getFunctionCounters(size_t index, SlangLLVMFunctionCounters* outCounters)
+{
+    if (!m_counters || index >= m_counters->getCount())
+    {
+        return SLANG_E_INVALID_ARG;
+    }
+    m_counters->get(index, *outCounters);
+    return SLANG_OK;
+}
+
+SlangResult LLVMJITSharedLibrary::findFunctionCounters(const char* name, SlangLLVMFunctionCounters* outCounters)
+{
+    return (m_counters && m_counters->find(name, *outCounters)) ? SLANG_OK : SLANG_E_NOT_FOUND;
+}
+
+void LLVMJITSharedLibrary::resetCounters()
+{
+    if (m_counters)
+    {
+        m_counters->reset();
+    }
+}
+
+SlangResult LLVMJITSharedLibrary::harvestProfile()
+{
+    return m_pgoCounters ? m_pgoCounters->harvest(PGOProfileStore::getSingleton()) : SLANG_E_NOT_AVAILABLE;
+}
+
+void* LLVMJITSharedLibrary::_findSymbolAddress(const char* name)
+{
+    if (m_tieredCode)
+    {
+        return m_tieredCode->findSymbol(name);
+    }
+
+    auto fnExpected = m_session->getJIT().lookup(*m_dylib, name);
     if (fnExpected)
     {
         auto fn = std::move(*fnExpected);
         return (void*)fn.getAddress();
     }
+    consumeError(fnExpected.takeError());
     return nullptr;
 }
 
@@ -471,6 +749,39 @@ static uint64_t __stdcall _aulldiv(uint64_t a, uint64_t b)
     x(memcmp, memcmp, int, (const void*, const void*, size_t)) \
     x(memset, memset, void*, (void*, int, size_t)) 
 
+// Intrinsics that the math functions are lowered to can be code generated as calls to the C library functions
+// name, cppName, retType, paramTypes
+#define SLANG_LLVM_LIBCALL_FUNCS(x) \
+    x(ceil, ceil, double, (double)) \
+    x(floor, floor, double, (double)) \
+    x(round, round, double, (double)) \
+    x(trunc, trunc, double, (double)) \
+    x(sqrt, sqrt, double, (double)) \
+    x(sin, sin, double, (double)) \
+    x(cos, cos, double, (double)) \
+    x(exp, exp, double, (double)) \
+    x(exp2, exp2, double, (double)) \
+    x(log, log, double, (double)) \
+    x(log2, log2, double, (double)) \
+    x(log10, log10, double, (double)) \
+    x(pow, pow, double, (double, double)) \
+    x(fmod, fmod, double, (double, double)) \
+    \
+    x(ceilf, ceilf, float, (float)) \
+    x(floorf, floorf, float, (float)) \
+    x(roundf, roundf, float, (float)) \
+    x(truncf, truncf, float, (float)) \
+    x(sqrtf, sqrtf, float, (float)) \
+    x(sinf, sinf, float, (float)) \
+    x(cosf, cosf, float, (float)) \
+    x(expf, expf, float, (float)) \
+    x(exp2f, exp2f, float, (float)) \
+    x(logf, logf, float, (float)) \
+    x(log2f, log2f, float, (float)) \
+    x(log10f, log10f, float, (float)) \
+    x(powf, powf, float, (float, float)) \
+    x(fmodf, fmodf, float, (float, float))
+
 #if SLANG_OSX
 #   define SLANG_PLATFORM_FUNCS(x) \
     x(memset_pattern4, memset_pattern4, void, (void*, const void*, size_t)) \
@@ -494,175 +805,677 @@ static uint64_t __stdcall _aulldiv(uint64_t a, uint64_t b)
 #   define SLANG_PLATFORM_FUNCS(x)
 #endif
 
-static int _getOptimizationLevel(DownstreamCompileOptions::OptimizationLevel level)
+void getBuiltinHostSymbols(std::vector<HostSymbol>& outSymbols)
 {
-    typedef DownstreamCompileOptions::OptimizationLevel OptimizationLevel;
-    switch (level)
+    static const NameAndFunc funcs[] =
     {
-        case OptimizationLevel::None:     return 0;
-        default:
-        case OptimizationLevel::Default:  return 1;
-        case OptimizationLevel::High:     return 2;
-        case OptimizationLevel::Maximal:  return 3;
+        SLANG_LLVM_FUNCS(SLANG_LLVM_FUNC)
+        SLANG_LLVM_LIBCALL_FUNCS(SLANG_LLVM_FUNC)
+        SLANG_PLATFORM_FUNCS(SLANG_LLVM_FUNC)
+    };
+
+    for (auto& func : funcs)
+    {
+        outSymbols.push_back(HostSymbol{ func.name, (void*)func.func });
+    }
+
+    // Vector variants of the maths functions, that vectorized code can call
+    VectorMathLibrary::getSingleton().getHostSymbols(outSymbols);
+
+#if SLANG_PTR_IS_32 && SLANG_VC
+    {
+        // https://docs.microsoft.com/en-us/windows/win32/devnotes/-win32-alldiv
+        outSymbols.push_back(HostSymbol{ "_alldiv", (void*)&WinSpecific::_alldiv });
+        outSymbols.push_back(HostSymbol{ "_allrem", (void*)&WinSpecific::_allrem });
+        outSymbols.push_back(HostSymbol{ "_aullrem", (void*)&WinSpecific::_aullrem });
+        outSymbols.push_back(HostSymbol{ "_aulldiv", (void*)&WinSpecific::_aulldiv });
     }
+#endif
 }
 
-static SlangResult _initLLVM()
+static ComPtr<IArtifactDiagnostics> _cloneDiagnostics(IArtifactDiagnostics* diagnostics)
 {
-    // Initialize targets first, so that --version shows registered targets.
-#if 0
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmPrinters();
-    llvm::InitializeAllAsmParsers();
-#else
-    // Just initialize items needed for this target.
+    ComPtr<IArtifactDiagnostics> clone(new ArtifactDiagnostics);
 
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+    const Count count = diagnostics->getCount();
+    for (Index i = 0; i < count; ++i)
+    {
+        clone->add(*diagnostics->getAt(i));
+    }
+    clone->setResult(diagnostics->getResult());
+    return clone;
+}
 
-    llvm::InitializeNativeTargetDisassembler();
-#endif
+static void _createSharedLibraryArtifact(SlangCompileTarget targetType, ISlangSharedLibrary* sharedLibrary, IArtifactDiagnostics* diagnostics, IArtifact** outArtifact)
+{
+    // Work out the ArtifactDesc 
+    const auto targetDesc = ArtifactDescUtil::makeDescForCompileTarget(targetType);
 
-    // Set an error handler, so that any LLVM backend diagnostics go through our
-    // error handler.
-    //llvm::install_fatal_error_handler(_llvmErrorHandler, static_cast<void*>(&clang->getDiagnostics()));
-    // NOTE! Can only be set once.
-    llvm::install_fatal_error_handler(_llvmErrorHandler, nullptr);
+    auto artifact = ArtifactUtil::createArtifact(targetDesc);
+    ArtifactUtil::addAssociated(artifact, diagnostics);
 
-    return SLANG_OK;
-}
+    artifact->addRepresentation(sharedLibrary);
 
+    *outArtifact = artifact.detach();
+}
 
-bool LLVMDownstreamCompiler::canConvert(const ArtifactDesc& from, const ArtifactDesc& to)
+static void _createDiagnosticsArtifact(IArtifactDiagnostics* diagnostics, IArtifact** outArtifact)
 {
-    return false;
+    auto artifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::None, ArtifactPayload::None));
+    ArtifactUtil::addAssociated(artifact, diagnostics);
+
+    *outArtifact = artifact.detach();
 }
 
-SlangResult LLVMDownstreamCompiler::convert(IArtifact* from, const ArtifactDesc& to, IArtifact** outArtifact)
+// Adds the error as a diagnostic, and marks the diagnostics as failed. Consumes the error.
+static void _addError(const char* prefix, llvm::Error err, IArtifactDiagnostics* diagnostics)
 {
-    return SLANG_E_NOT_IMPLEMENTED;
+    const std::string errorString = llvm::toString(std::move(err));
+
+    StringBuilder buf;
+    buf << prefix << errorString.c_str();
+
+    ArtifactDiagnostic diagnostic;
+
+    diagnostic.severity = ArtifactDiagnostic::Severity::Error;
+    diagnostic.stage = ArtifactDiagnostic::Stage::Link;
+    diagnostic.text = TerminatedCharSlice(buf.getBuffer(), buf.getLength());
+
+    // Add the error
+    diagnostics->add(diagnostic);
+    diagnostics->setResult(SLANG_FAIL);
 }
 
-SlangResult LLVMDownstreamCompiler::getVersionString(slang::IBlob** outVersionString)
+static void _addWarning(const char* text, IArtifactDiagnostics* diagnostics)
 {
-    StringBuilder versionString;
-    // Append the version
-    m_desc.version.append(versionString);
+    ArtifactDiagnostic diagnostic;
 
-    // Really we should have a hash to identify the specific version.
-    // For now we'll fall back to just using the timestamp
+    diagnostic.severity = ArtifactDiagnostic::Severity::Warning;
+    diagnostic.stage = ArtifactDiagnostic::Stage::Link;
+    diagnostic.text = TerminatedCharSlice(text, ::strlen(text));
 
-    {
-        // If we don't have the commitHash, we use the library timestamp, to uniquely identify.
-        versionString << " " << SharedLibraryUtils::getSharedLibraryTimestamp((void*)createLLVMDownstreamCompiler_V4);
-    }
+    diagnostics->add(diagnostic);
+}
 
-    *outVersionString = StringBlob::moveCreate(versionString).detach();
+// Adds the error to the diagnostics, and outputs an artifact holding the diagnostics
+static SlangResult _failWithError(const char* prefix, llvm::Error err, IArtifactDiagnostics* diagnostics, IArtifact** outArtifact)
+{
+    _addError(prefix, std::move(err), diagnostics);
+    _createDiagnosticsArtifact(diagnostics, outArtifact);
     return SLANG_OK;
 }
 
-void* LLVMDownstreamCompiler::castAs(const Guid& guid)
+/* The forms an artifact can take as it goes through compilation. Conversions go from an earlier form to a later
+one, with the exception that LLVM IR and bitcode can be converted between each other. */
+enum class PipelineForm
 {
-    if (auto ptr = getInterface(guid))
+    Unknown,
+    Source,                 ///< C or C++ source
+    LLVMIR,                 ///< Textual LLVM IR
+    LLVMBitcode,            ///< LLVM bitcode
+    ObjectCode,             ///< Native object code for the host
+    HostCallable,           ///< JIT'd code for the host
+};
+
+static PipelineForm _getPipelineForm(const ArtifactDesc& desc)
+{
+    switch (desc.kind)
     {
-        return ptr;
+        case ArtifactKind::Source:
+        {
+            return (desc.payload == ArtifactPayload::C || desc.payload == ArtifactPayload::Cpp) ? PipelineForm::Source : PipelineForm::Unknown;
+        }
+        case ArtifactKind::Assembly:
+        {
+            return (desc.payload == ArtifactPayload::LLVMIR) ? PipelineForm::LLVMIR : PipelineForm::Unknown;
+        }
+        case ArtifactKind::ObjectCode:
+        {
+            switch (desc.payload)
+            {
+                case ArtifactPayload::LLVMIR:   return PipelineForm::LLVMBitcode;
+                case ArtifactPayload::HostCPU:  return PipelineForm::ObjectCode;
+                default: break;
+            }
+            break;
+        }
+        case ArtifactKind::HostCallable:
+        case ArtifactKind::SharedLibrary:
+        {
+            return (desc.payload == ArtifactPayload::HostCPU) ? PipelineForm::HostCallable : PipelineForm::Unknown;
+        }
+        default: break;
     }
-    return getObject(guid);
+    return PipelineForm::Unknown;
 }
 
-void* LLVMDownstreamCompiler::getInterface(const Guid& guid)
+static bool _isIRForm(PipelineForm form) { return form == PipelineForm::LLVMIR || form == PipelineForm::LLVMBitcode; }
+
+// Parse IR (textual or bitcode) into the context. Problems are reported to diagnostics.
+static std::unique_ptr<llvm::Module> _parseIR(ISlangBlob* blob, LLVMContext& context, IArtifactDiagnostics* diagnostics)
 {
-    if (guid == ISlangUnknown::getTypeGuid() ||
-        guid == ICastable::getTypeGuid() ||
-        guid == IDownstreamCompiler::getTypeGuid())
+    const StringRef data((const char*)blob->getBufferPointer(), blob->getBufferSize());
+    MemoryBufferRef memoryBufferRef(data, "slang-llvm-ir");
+
+    SMDiagnostic err;
+    auto module = llvm::parseIR(memoryBufferRef, err, context);
+    if (!module)
     {
-        return static_cast<IDownstreamCompiler*>(this);
+        const std::string message = err.getMessage().str();
+
+        ArtifactDiagnostic diagnostic;
+        diagnostic.severity = ArtifactDiagnostic::Severity::Error;
+        diagnostic.stage = ArtifactDiagnostic::Stage::Compile;
+        diagnostic.text = TerminatedCharSlice(message.c_str(), Count(message.size()));
+        diagnostic.location.line = err.getLineNo();
+
+        diagnostics->add(diagnostic);
+        diagnostics->setResult(SLANG_FAIL);
     }
-    return nullptr;
+    return module;
 }
 
-void* LLVMDownstreamCompiler::getObject(const Guid& guid)
+// Write the module as the form (which must be IR, bitcode or object code) into a blob.
+static SlangResult _emitModule(llvm::Module& module, PipelineForm form, IArtifactDiagnostics* diagnostics, ComPtr<ISlangBlob>& outBlob)
 {
-    SLANG_UNUSED(guid);
-    return nullptr;
-}
+    SmallVector<char, 0> output;
+    llvm::raw_svector_ostream stream(output);
 
-SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IArtifact** outArtifact)
-{
-    if (!isVersionCompatible(inOptions))
+    switch (form)
     {
-        // Not possible to compile with this version of the interface.
-        return SLANG_E_NOT_IMPLEMENTED;
-    }
+        case PipelineForm::LLVMIR:
+        {
+            module.print(stream, nullptr);
+            break;
+        }
+        case PipelineForm::LLVMBitcode:
+        {
+            llvm::WriteBitcodeToFile(module, stream);
+            break;
+        }
+        case PipelineForm::ObjectCode:
+        {
+            auto jtmbExpected = TargetCPU::get().createJITTargetMachineBuilder();
+            if (!jtmbExpected)
+            {
+                _addError("Unable to detect host: ", jtmbExpected.takeError(), diagnostics);
+                return SLANG_FAIL;
+            }
 
-    CompileOptions options = getCompatibleVersion(&inOptions);
+            auto targetMachineExpected = jtmbExpected->createTargetMachine();
+            if (!targetMachineExpected)
+            {
+                _addError("Unable to create target machine: ", targetMachineExpected.takeError(), diagnostics);
+                return SLANG_FAIL;
+            }
+            auto& targetMachine = **targetMachineExpected;
 
-    // Currently supports single source file
-    if (options.sourceArtifacts.count != 1)
-    {
-        return SLANG_FAIL;
+            if (module.getDataLayout().isDefault())
+            {
+                module.setDataLayout(targetMachine.createDataLayout());
+            }
+
+            llvm::legacy::PassManager passManager;
+            if (targetMachine.addPassesToEmitFile(passManager, stream, nullptr, CGFT_ObjectFile))
+            {
+                _addError("Unable to emit object code: ", llvm::make_error<StringError>("target can't emit object files", inconvertibleErrorCode()), diagnostics);
+                return SLANG_FAIL;
+            }
+            passManager.run(module);
+            break;
+        }
+        default: return SLANG_FAIL;
     }
-    IArtifact* sourceArtifact = options.sourceArtifacts[0];
 
-    _ensureSufficientStack();
+    outBlob = RawBlob::create(output.data(), output.size());
+    return SLANG_OK;
+}
 
-    static const SlangResult initLLVMResult = _initLLVM();
-    SLANG_RETURN_ON_FAIL(initLLVMResult);
+static void _createBlobArtifact(const ArtifactDesc& desc, ISlangBlob* blob, IArtifactDiagnostics* diagnostics, IArtifact** outArtifact)
+{
+    auto artifact = ArtifactUtil::createArtifact(desc);
+    ArtifactUtil::addAssociated(artifact, diagnostics);
 
-    std::unique_ptr<CompilerInstance> clang(new CompilerInstance());
-    IntrusiveRefCntPtr<DiagnosticIDs> diagID(new DiagnosticIDs());
+    artifact->addRepresentationUnknown(blob);
 
-    // Register the support for object-file-wrapped Clang modules.
-    auto pchOps = clang->getPCHContainerOperations();
-    pchOps->registerWriter(std::make_unique<ObjectFilePCHContainerWriter>());
-    pchOps->registerReader(std::make_unique<ObjectFilePCHContainerReader>());
+    *outArtifact = artifact.detach();
+}
 
-    IntrusiveRefCntPtr<DiagnosticOptions> diagOpts = new DiagnosticOptions();
+/* A translation unit of a compilation. Each unit is compiled independently (and potentially in parallel), and
+all of the units of a compilation are loaded into the same JITDylib. */
+struct TranslationUnit
+{
+    ComPtr<ISlangBlob> sourceBlob;
+    PipelineForm form = PipelineForm::Source;               ///< The form of the source, can be C/C++ source, or LLVM IR
+    std::string cacheKey;                                   ///< The compile cache key for this unit alone
+    std::string objectKey;                                  ///< If set the object produced is captured for the compile cache
+    bool isObjectStored = false;                            ///< If set the object produced is also stored in the object cache
+
+    ComPtr<IArtifactDiagnostics> diagnostics;               ///< Diagnostics for just this unit
+    SlangResult result = SLANG_OK;                          ///< A failure that can't be reported via diagnostics
+
+    std::vector<std::string> exportedNames;                 ///< The names of the symbols the unit makes available outside of itself
+    ThreadSafeModule module;                                ///< The module produced by compilation
+    std::unique_ptr<llvm::MemoryBuffer> object;             ///< Or the object, if loaded from the object cache
+    std::string tier1Bitcode;                               ///< If tiered, the unoptimized module, to optimize for tier 1
+    std::string countersName;                               ///< If set, the module's functions are counted, in the array with this name
+    std::vector<std::string> counterNames;                  ///< The names of the counted functions, in counter order
+    std::string pgoCountersName;                            ///< If set, the module is instrumented to collect a profile, in the array with this name
+    PGOCounterLayout pgoLayout;                             ///< Where the profile counters of each function are
+    std::string profileKey;                                 ///< The key of the profile for this unit, if collecting or using one
+    std::shared_ptr<const PGOModuleProfile> pgoProfile;     ///< If set, the profile used to optimize the module
+
+    SlangLLVMCompileMetrics metrics = {};                   ///< The total time is the CPU time of the thread that compiled the unit
+};
 
-    ComPtr<IArtifactDiagnostics> diagnostics(new ArtifactDiagnostics);
+// Add the names of the symbols the module makes available outside of itself
+static void _addExportedNames(const llvm::Module& module, std::vector<std::string>& ioNames)
+{
+    for (const auto& value : module.global_values())
+    {
+        if (!value.isDeclarationForLinker() && !value.hasLocalLinkage() && value.hasDefaultVisibility() && !value.getName().startswith("llvm."))
+        {
+            ioNames.push_back(value.getName().str());
+        }
+    }
+}
 
-    
-    // TODO(JS): We might just want this to talk directly to the listener.
-    // For now we just buffer up. 
-    BufferedDiagnosticConsumer diagsBuffer(diagnostics);
+// Add the names of the symbols the object makes available outside of itself. globalPrefix is removed from names, such
+// that they are unmangled, as with a module.
+static void _addExportedNames(const llvm::MemoryBuffer& object, char globalPrefix, std::vector<std::string>& ioNames)
+{
+    auto objectExpected = llvm::object::ObjectFile::createObjectFile(object.getMemBufferRef());
+    if (!objectExpected)
+    {
+        consumeError(objectExpected.takeError());
+        return;
+    }
 
-    IntrusiveRefCntPtr<DiagnosticsEngine> diags = new DiagnosticsEngine(diagID, diagOpts, &diagsBuffer, false);
+    for (const auto& symbol : (*objectExpected)->symbols())
+    {
+        auto flagsExpected = symbol.getFlags();
+        if (!flagsExpected)
+        {
+            consumeError(flagsExpected.takeError());
+            continue;
+        }
+        const uint32_t flags = *flagsExpected;
+        if ((flags & llvm::object::SymbolRef::SF_Global) == 0 ||
+            (flags & (llvm::object::SymbolRef::SF_Undefined | llvm::object::SymbolRef::SF_Hidden | llvm::object::SymbolRef::SF_FormatSpecific)))
+        {
+            continue;
+        }
 
-    ComPtr<ISlangBlob> sourceBlob;
-    SLANG_RETURN_ON_FAIL(sourceArtifact->loadBlob(ArtifactKeep::Yes, sourceBlob.writeRef()));
+        auto nameExpected = symbol.getName();
+        if (!nameExpected)
+        {
+            consumeError(nameExpected.takeError());
+            continue;
+        }
 
-    const auto sourceSlice = StringUtil::getSlice(sourceBlob);
-    StringRef sourceStringRef(sourceSlice.begin(), sourceSlice.getLength());
+        StringRef name = *nameExpected;
+        if (globalPrefix && name.startswith(StringRef(&globalPrefix, 1)))
+        {
+            name = name.drop_front(1);
+        }
+        ioNames.push_back(name.str());
+    }
+}
 
-    auto sourceBuffer = llvm::MemoryBuffer::getMemBuffer(sourceStringRef);
+/* Materialize all of the exported symbols, and then move them from the JIT's symbol table into a SymbolTable held by
+the library. The memory for code and data is still held by the JIT, and is released along with the library. */
+static llvm::Error _freezeSharedLibrary(JITSession& session, JITDylib& dylib, const std::vector<std::string>& names, LLVMJITSharedLibrary* sharedLibrary)
+{
+    std::vector<const char*> namePtrs;
+    for (const auto& name : names)
+    {
+        namePtrs.push_back(name.c_str());
+    }
 
-    auto& invocation = clang->getInvocation();
+    std::vector<void*> addresses(names.size());
+    if (auto err = session.lookupSymbols(dylib, namePtrs.data(), namePtrs.size(), addresses.data()))
+    {
+        return err;
+    }
 
-    std::string verboseOutputString;
+    auto symbols = std::make_unique<SymbolTable>();
+    symbols->init(names, addresses.data());
 
-    // Capture all of the verbose output into a buffer, so not writen to stdout
-    clang->setVerboseOutputStream(std::make_unique<llvm::raw_string_ostream>(verboseOutputString));
+    // Only remove what was found
+    namePtrs.clear();
+    for (size_t i = 0; i < symbols->getCount(); ++i)
+    {
+        namePtrs.push_back(symbols->getName(i));
+    }
+    if (auto err = session.removeSymbols(dylib, namePtrs.data(), namePtrs.size()))
+    {
+        return err;
+    }
 
-    SmallVector<char> output;
-    clang->setOutputStream(std::make_unique<llvm::raw_svector_ostream>(output));
+    sharedLibrary->setFrozenSymbols(std::move(symbols));
+    return Error::success();
+}
 
-    frontend::ActionKind action = frontend::ActionKind::EmitLLVMOnly;
+// Artifacts with counters, or that are used to collect a profile, hold state that belongs to whoever compiled them, so
+// can't be shared through the compile cache. The cache holds object code, and lazily compiled and tiered modules
+// don't produce a single object.
+static bool _isCompileCacheable(const LLVMCompileOptions& llvmOptions)
+{
+    return !llvmOptions.counters && !llvmOptions.pgoGenerate && !llvmOptions.lazy && !llvmOptions.tiered;
+}
 
-    // EmitCodeGenOnly doesn't appear to actually emit anything
-    // EmitLLVM outputs LLVM assembly
-    // EmitLLVMOnly doesn't 'emit' anything, but the IR that is produced is accessible, from the 'action'.
+/* JIT the units. Each unit is either a module, or an object (as loaded from the object cache). On success outputs a host callable
+artifact, and adds the object code of the units to the compile cache (if cacheable, and cacheKey isn't empty).
 
-    action = frontend::ActionKind::EmitLLVMOnly;
+The artifact is held in its own JITDylib in the shared JITSession. If lazy compilation is enabled, functions in the modules
+are only compiled when first looked up or called. If tiered, the modules are unoptimized, and tier 1 code is produced from
+each unit's tier1Bitcode in the background. If frozen, the library holds the symbols rather than the JIT. If counted, the
+library holds the counters the modules were instrumented to update, and likewise for collecting a profile. */
+static SlangResult _createJITArtifact(const DownstreamCompileOptions& options, const LLVMCompileOptions& llvmOptions, const std::string& cacheKey, std::vector<TranslationUnit>& units, IArtifactDiagnostics* diagnostics, IArtifact** outArtifact)
+{
+    std::shared_ptr<JITSession> session;
+    {
+        std::string errorString;
+        if (SLANG_FAILED(JITSession::get(session, errorString)))
+        {
+            return _failWithError("Unable to create JIT engine: ", llvm::make_error<StringError>(errorString, inconvertibleErrorCode()), diagnostics, outArtifact);
+        }
+    }
 
-    //action = frontend::ActionKind::EmitBC;
-    //action = frontend::ActionKind::EmitLLVM;
-    // 
-    //action = frontend::ActionKind::EmitCodeGenOnly;
-    //action = frontend::ActionKind::EmitObj;
-    //action = frontend::ActionKind::EmitAssembly;
+    auto& jit = session->getJIT();
+
+    auto dylibExpected = session->createArtifactDylib();
+    if (!dylibExpected)
+    {
+        return _failWithError("Unable to create JIT library: ", dylibExpected.takeError(), diagnostics, outArtifact);
+    }
+
+    JITDylib& dylib = *dylibExpected;
+
+    // Use the default tracker, such that anything added to the dylib (such as by lazy compilation) is tracked
+    ResourceTrackerSP tracker = dylib.getDefaultResourceTracker();
+
+    // Create the shared library first, so on failure whatever has been added to the JIT is released
+    LLVMJITSharedLibrary* jitSharedLibrary = new LLVMJITSharedLibrary(session, &dylib);
+    ComPtr<ISlangSharedLibrary> sharedLibrary(jitSharedLibrary);
+
+    std::shared_ptr<TieredCode> tieredCode;
+    if (llvmOptions.tiered)
+    {
+        auto tieredCodeExpected = TieredCode::create(session, dylib);
+        if (!tieredCodeExpected)
+        {
+            return _failWithError("Unable to create tiered JIT library: ", tieredCodeExpected.takeError(), diagnostics, outArtifact);
+        }
+        tieredCode = std::move(*tieredCodeExpected);
+        jitSharedLibrary->setTieredCode(tieredCode);
+    }
+
+    // The counters must be defined before the code that references them is JIT'd
+    if (llvmOptions.counters)
+    {
+        std::vector<std::string> counterNames;
+        for (auto& unit : units)
+        {
+            counterNames.insert(counterNames.end(), unit.counterNames.begin(), unit.counterNames.end());
+        }
+
+        auto counters = std::make_unique<JITCounters>();
+        counters->init(std::move(counterNames));
+
+        // The counters of each unit follow those of the previous unit
+        std::vector<HostSymbol> counterSymbols;
+        auto data = (SlangLLVMFunctionCounters*)counters->getData();
+        for (auto& unit : units)
+        {
+            if (unit.counterNames.size())
+            {
+                counterSymbols.push_back(HostSymbol{ unit.countersName.c_str(), data });
+                data += unit.counterNames.size();
+            }
+        }
+
+        if (auto err = session->defineSymbols(dylib, counterSymbols.data(), counterSymbols.size()))
+        {
+            return _failWithError("Unable to define JIT counters: ", std::move(err), diagnostics, outArtifact);
+        }
+        jitSharedLibrary->setCounters(std::move(counters));
+    }
+
+    if (llvmOptions.pgoGenerate)
+    {
+        std::vector<JITPGOCounters::Unit> pgoUnits;
+        for (auto& unit : units)
+        {
+            JITPGOCounters::Unit pgoUnit;
+            pgoUnit.profileKey = unit.profileKey;
+            pgoUnit.layout = std::move(unit.pgoLayout);
+            pgoUnits.push_back(std::move(pgoUnit));
+        }
+
+        auto pgoCounters = std::make_unique<JITPGOCounters>();
+        pgoCounters->init(std::move(pgoUnits));
+
+        std::vector<HostSymbol> counterSymbols;
+        for (size_t i = 0; i < units.size(); ++i)
+        {
+            if (pgoCounters->getUnit(i).layout.counterCount)
+            {
+                counterSymbols.push_back(HostSymbol{ units[i].pgoCountersName.c_str(), pgoCounters->getUnitData(i) });
+            }
+        }
+
+        if (auto err = session->defineSymbols(dylib, counterSymbols.data(), counterSymbols.size()))
+        {
+            return _failWithError("Unable to define JIT profile counters: ", std::move(err), diagnostics, outArtifact);
+        }
+        jitSharedLibrary->setPGOCounters(std::move(pgoCounters));
+    }
+
+    const bool isLazy = llvmOptions.lazy && session->isLazySupported();
+    if (llvmOptions.lazy && !isLazy)
+    {
+        _addWarning("Lazy compilation is not supported on this target, compiling eagerly", diagnostics);
+    }
+
+    // The object code of each unit, for the compile cache. Units that are objects are copied, the objects of modules
+    // are captured as the JIT produces them (when they are materialized). Captures are ended on return.
+    const bool isCached = !cacheKey.empty() && _isCompileCacheable(llvmOptions);
+    std::vector<std::shared_ptr<const llvm::MemoryBuffer>> cachedObjects(isCached ? units.size() : 0);
+    std::vector<std::string> capturedKeys;
+    auto endCaptures = llvm::make_scope_exit([&]()
+    {
+        for (const auto& key : capturedKeys)
+        {
+            DiskObjectCache::getSingleton().takeCapturedObject(key);
+        }
+    });
+
+    // The names of the symbols the units export
+    std::vector<std::string> exportedNames;
+    const char globalPrefix = jit.getDataLayout().getGlobalPrefix();
+
+    // Symbols defined in one unit are resolved in other units, as they are all in the same dylib
+    for (size_t i = 0; i < units.size(); ++i)
+    {
+        auto& unit = units[i];
+
+        // The names for modules are found when they are compiled
+        if (unit.object)
+        {
+            _addExportedNames(*unit.object, globalPrefix, unit.exportedNames);
+        }
+        exportedNames.insert(exportedNames.end(), unit.exportedNames.begin(), unit.exportedNames.end());
+
+        if (isCached)
+        {
+            if (unit.object)
+            {
+                cachedObjects[i] = llvm::MemoryBuffer::getMemBufferCopy(unit.object->getBuffer(), unit.object->getBufferIdentifier());
+            }
+            else if (!unit.objectKey.empty())
+            {
+                DiskObjectCache::getSingleton().captureObject(unit.objectKey);
+                capturedKeys.push_back(unit.objectKey);
+            }
+        }
+
+        if (unit.object)
+        {
+            if (auto err = jit.addObjectFile(tracker, std::move(unit.object)))
+            {
+                return _failWithError("Unable to add object to JIT: ", std::move(err), diagnostics, outArtifact);
+            }
+        }
+        else if (isLazy)
+        {
+            if (auto err = session->addLazyIRModule(dylib, std::move(unit.module)))
+            {
+                return _failWithError("Unable to add lazy module to JIT: ", std::move(err), diagnostics, outArtifact);
+            }
+        }
+        else
+        {
+            if (auto err = jit.addIRModule(tracker, std::move(unit.module)))
+            {
+                return _failWithError("Unable to add module to JIT: ", std::move(err), diagnostics, outArtifact);
+            }
+        }
+    }
+
+    if (auto err = jit.initialize(dylib))
+    {
+        return _failWithError("Unable to initialize JIT library: ", std::move(err), diagnostics, outArtifact);
+    }
+
+    // A (non inline) symbol should only be defined once, but inline functions and the like can be defined by each unit
+    std::sort(exportedNames.begin(), exportedNames.end());
+    exportedNames.erase(std::unique(exportedNames.begin(), exportedNames.end()), exportedNames.end());
+
+    // The JIT only generates code for a module (or links an object) when a symbol in it is first looked up. Unless
+    // lazy, do that now, so code generation and linking are part of the compilation (and are timed as such), and
+    // problems are reported here rather than being a symbol that can't be found. Freezing looks up everything anyway.
+    if (!isLazy && !llvmOptions.frozen)
+    {
+        llvm::TimeTraceScope timeScope("JITMaterialize");
+
+        std::vector<const char*> namePtrs;
+        for (const auto& name : exportedNames)
+        {
+            namePtrs.push_back(name.c_str());
+        }
+
+        std::vector<void*> addresses(namePtrs.size());
+        if (auto err = session->lookupSymbols(dylib, namePtrs.data(), namePtrs.size(), addresses.data()))
+        {
+            return _failWithError("Unable to materialize JIT library: ", std::move(err), diagnostics, outArtifact);
+        }
+    }
+
+    if (llvmOptions.frozen)
+    {
+        if (auto err = _freezeSharedLibrary(*session, dylib, exportedNames, jitSharedLibrary))
+        {
+            return _failWithError("Unable to freeze JIT library: ", std::move(err), diagnostics, outArtifact);
+        }
+    }
+    else
+    {
+        jitSharedLibrary->setExportedNames(std::move(exportedNames));
+    }
+
+    if (tieredCode)
+    {
+        std::vector<std::string> bitcodes;
+        for (auto& unit : units)
+        {
+            bitcodes.push_back(std::move(unit.tier1Bitcode));
+        }
+        tieredCode->startTierUp(llvmOptions.profile, std::move(bitcodes));
+    }
+
+    // Add to the cache, if there is an object for every unit. We hold a clone of the diagnostics, as the artifacts
+    // diagnostics could be changed.
+    if (isCached)
+    {
+        CompileCache::Entry entry;
+        entry.diagnostics = _cloneDiagnostics(diagnostics);
+
+        bool hasAllObjects = true;
+        for (size_t i = 0; i < units.size() && hasAllObjects; ++i)
+        {
+            if (!cachedObjects[i] && !units[i].objectKey.empty())
+            {
+                cachedObjects[i] = DiskObjectCache::getSingleton().takeCapturedObject(units[i].objectKey);
+            }
+            hasAllObjects = cachedObjects[i] != nullptr;
+            entry.sizeInBytes += hasAllObjects ? cachedObjects[i]->getBufferSize() : 0;
+        }
+
+        if (hasAllObjects)
+        {
+            entry.objects = std::move(cachedObjects);
+            CompileCache::getSingleton().add(cacheKey, entry);
+        }
+    }
+
+    _createSharedLibraryArtifact(options.targetType, sharedLibrary, diagnostics, outArtifact);
+    return SLANG_OK;
+}
+
+/* Create an artifact from a compile cache entry. The entry's objects are linked into a new library, so the artifact
+doesn't share code or data with other artifacts of the same compilation. */
+static SlangResult _createJITArtifactFromCache(const DownstreamCompileOptions& options, const LLVMCompileOptions& llvmOptions, const CompileCache::Entry& entry, IArtifact** outArtifact)
+{
+    std::vector<TranslationUnit> units(entry.objects.size());
+    for (size_t i = 0; i < units.size(); ++i)
+    {
+        units[i].object = llvm::MemoryBuffer::getMemBufferCopy(entry.objects[i]->getBuffer(), entry.objects[i]->getBufferIdentifier());
+    }
+
+    // The entry holds all of the diagnostics of the compilation. There is no key, as the entry is already cached.
+    return _createJITArtifact(options, llvmOptions, std::string(), units, _cloneDiagnostics(entry.diagnostics), outArtifact);
+}
+
+static SlangResult _initLLVM()
+{
+    // Initialize targets first, so that --version shows registered targets.
+#if 0
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmPrinters();
+    llvm::InitializeAllAsmParsers();
+#else
+    // Just initialize items needed for this target.
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
 
+    llvm::InitializeNativeTargetDisassembler();
+#endif
+
+    // Set an error handler, so that any LLVM backend diagnostics go through our
+    // error handler.
+    //llvm::install_fatal_error_handler(_llvmErrorHandler, static_cast<void*>(&clang->getDiagnostics()));
+    // NOTE! Can only be set once.
+    llvm::install_fatal_error_handler(_llvmErrorHandler, nullptr);
+
+    return SLANG_OK;
+}
+
+SlangResult initLLVM()
+{
+    static const SlangResult initLLVMResult = _initLLVM();
+    return initLLVMResult;
+}
+
+
+/* Set up the invocation from the options. The inputs and the action are not set.
+
+Clang doesn't run the LLVM optimization passes, the module is optimized afterwards with the profile. */
+static SlangResult _initInvocation(const DownstreamCompileOptions& options, const OptimizationProfile& profile, CompilerInvocation& invocation, InputKind& outInputKind)
+{
     Language language;
     LangStandard::Kind langStd;
     switch (options.sourceLanguage)
@@ -686,22 +1499,7 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
     }
 
     const InputKind inputKind(language, InputKind::Format::Source);
-
-    {
-        auto& opts = invocation.getFrontendOpts();
-
-        // Add the source
-        // TODO(JS): For the moment this kind of include does *NOT* show a input source filename
-        // not super surprising as one isn't set, but it's not clear how one would be set when the input is a memory buffer.
-        // For Slang usage, this probably isn't an issue, because it's *output* typically holds #line directives.
-        {
-            
-            FrontendInputFile inputFile(*sourceBuffer, inputKind);
-            opts.Inputs.push_back(inputFile);
-        }
-
-        opts.ProgramAction = action;
-    }
+    outInputKind = inputKind;
 
     {
         auto& opts = invocation.getPreprocessorOpts();
@@ -731,6 +1529,12 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
 
         opts.Triple = LLVM_DEFAULT_TARGET_TRIPLE;
 
+        // Generate code for the target CPU (by default the host), such that its features (such as AVX2) can be used.
+        // The CPU and features are recorded on each function in the IR, and so are used by the JIT.
+        const auto& targetCPU = TargetCPU::get();
+        opts.CPU = targetCPU.name;
+        opts.FeaturesAsWritten = targetCPU.features;
+
         // A code model isn't set by default, "default" seems to fit the bill here 
         opts.CodeModel = "default";
 
@@ -752,6 +1556,10 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
         {
             opts->FastMath = true;
         }
+
+        // Defines __OPTIMIZE__ and __OPTIMIZE_SIZE__ as -O does
+        opts->Optimize = profile.optLevel > 0;
+        opts->OptimizeSize = profile.sizeLevel > 0;
     }
 
     {
@@ -762,19 +1570,299 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
         opts.UseStandardSystemIncludes = true;
         opts.UseStandardCXXIncludes = true;
 
-        /// Use libc++ instead of the default libstdc++.
-        //opts.UseLibcxx = true;
+        /// Use libc++ instead of the default libstdc++.
+        //opts.UseLibcxx = true;
+    }
+
+
+    {
+        auto& opts = invocation.getCodeGenOpts();
+
+        // Set to -O optimization level. This controls the attributes in the IR (such as optsize), but as passes are
+        // disabled, not the optimizations themselves.
+        opts.OptimizationLevel = profile.optLevel;
+        opts.OptimizeSize = profile.sizeLevel;
+        opts.DisableLLVMPasses = true;
+
+        // Copy over the targets CodeModel
+        opts.CodeModel = invocation.getTargetOpts().CodeModel;
+
+        // If JIT'd code is registered with debuggers or profilers, include line tables so they can map code back to
+        // the source. Clang takes #line directives into account, so the lines are those of the Slang source.
+        if (JITSession::getEventListenerFlags())
+        {
+            opts.setDebugInfo(codegenoptions::DebugLineTablesOnly);
+            opts.DwarfVersion = 4;
+        }
+    }
+
+    return SLANG_OK;
+}
+
+/* Build a precompiled header for the prelude, with the options, writing it to pchPath. */
+static SlangResult _buildPrecompiledHeader(const DownstreamCompileOptions& options, const OptimizationProfile& profile, StringRef prelude, const std::string& pchPath)
+{
+    std::unique_ptr<CompilerInstance> clang(new CompilerInstance());
+    IntrusiveRefCntPtr<DiagnosticIDs> diagID(new DiagnosticIDs());
+
+    auto pchOps = clang->getPCHContainerOperations();
+    pchOps->registerWriter(std::make_unique<ObjectFilePCHContainerWriter>());
+    pchOps->registerReader(std::make_unique<ObjectFilePCHContainerReader>());
+
+    IntrusiveRefCntPtr<DiagnosticOptions> diagOpts = new DiagnosticOptions();
+
+    // Diagnostics are not reported - if the prelude can't be built, compilations report the problem
+    ComPtr<IArtifactDiagnostics> diagnostics(new ArtifactDiagnostics);
+    BufferedDiagnosticConsumer diagsBuffer(diagnostics);
+
+    IntrusiveRefCntPtr<DiagnosticsEngine> diags = new DiagnosticsEngine(diagID, diagOpts, &diagsBuffer, false);
+
+    auto& invocation = clang->getInvocation();
+
+    std::string verboseOutputString;
+    clang->setVerboseOutputStream(std::make_unique<llvm::raw_string_ostream>(verboseOutputString));
+
+    // The PCH has to be set up in the same way as the compilations that use it
+    InputKind inputKind;
+    SLANG_RETURN_ON_FAIL(_initInvocation(options, profile, invocation, inputKind));
+
+    auto preludeBuffer = llvm::MemoryBuffer::getMemBuffer(prelude, "slang-prelude.h");
+
+    {
+        auto& opts = invocation.getFrontendOpts();
+
+        FrontendInputFile inputFile(*preludeBuffer, inputKind);
+        opts.Inputs.push_back(inputFile);
+
+        opts.ProgramAction = frontend::ActionKind::GeneratePCH;
+        opts.OutputFile = pchPath;
+    }
+
+    clang->createDiagnostics();
+    clang->setDiagnostics(diags.get());
+
+    if (!clang->hasDiagnostics())
+        return SLANG_FAIL;
+
+    clang->createFileManager();
+    clang->createSourceManager(clang->getFileManager());
+
+    std::unique_ptr<FrontendAction> act = CreateFrontendAction(*clang);
+    if (!act)
+    {
+        return SLANG_FAIL;
+    }
+
+    if (!clang->ExecuteAction(*act) || diagsBuffer.hasError())
+    {
+        return SLANG_FAIL;
+    }
+
+    return SLANG_OK;
+}
+
+SlangResult LLVMDownstreamCompiler::getVersionString(slang::IBlob** outVersionString)
+{
+    StringBuilder versionString;
+    // Append the version
+    m_desc.version.append(versionString);
+
+    // Really we should have a hash to identify the specific version.
+    // For now we'll fall back to just using the timestamp
+
+    {
+        // If we don't have the commitHash, we use the library timestamp, to uniquely identify.
+        versionString << " " << SharedLibraryUtils::getSharedLibraryTimestamp((void*)createLLVMDownstreamCompiler_V4);
+    }
+
+    *outVersionString = StringBlob::moveCreate(versionString).detach();
+    return SLANG_OK;
+}
+
+void* LLVMDownstreamCompiler::castAs(const Guid& guid)
+{
+    if (auto ptr = getInterface(guid))
+    {
+        return ptr;
+    }
+    return getObject(guid);
+}
+
+void* LLVMDownstreamCompiler::getInterface(const Guid& guid)
+{
+    if (guid == ISlangUnknown::getTypeGuid() ||
+        guid == ICastable::getTypeGuid() ||
+        guid == IDownstreamCompiler::getTypeGuid())
+    {
+        return static_cast<IDownstreamCompiler*>(this);
+    }
+    return nullptr;
+}
+
+void* LLVMDownstreamCompiler::getObject(const Guid& guid)
+{
+    SLANG_UNUSED(guid);
+    return nullptr;
+}
+
+/* Forwards to the consumer that generates IR, timing the calls into it.
+
+Clang parses, performs semantic analysis and generates IR a top level declaration at a time, so IR generation can
+only be timed by timing the consumer. Calls can nest, so only the outermost call is timed. */
+class IRGenTimingConsumer : public ASTConsumer
+{
+public:
+    virtual void Initialize(ASTContext& context) override { Scope scope(this); m_consumer->Initialize(context); }
+    virtual bool HandleTopLevelDecl(DeclGroupRef decls) override { Scope scope(this); return m_consumer->HandleTopLevelDecl(decls); }
+    virtual void HandleInlineFunctionDefinition(FunctionDecl* decl) override { Scope scope(this); m_consumer->HandleInlineFunctionDefinition(decl); }
+    virtual void HandleInterestingDecl(DeclGroupRef decls) override { Scope scope(this); m_consumer->HandleInterestingDecl(decls); }
+    virtual void HandleTranslationUnit(ASTContext& context) override { Scope scope(this); m_consumer->HandleTranslationUnit(context); }
+    virtual void HandleTagDeclDefinition(TagDecl* decl) override { Scope scope(this); m_consumer->HandleTagDeclDefinition(decl); }
+    virtual void HandleTagDeclRequiredDefinition(const TagDecl* decl) override { Scope scope(this); m_consumer->HandleTagDeclRequiredDefinition(decl); }
+    virtual void HandleCXXImplicitFunctionInstantiation(FunctionDecl* decl) override { Scope scope(this); m_consumer->HandleCXXImplicitFunctionInstantiation(decl); }
+    virtual void HandleTopLevelDeclInObjCContainer(DeclGroupRef decls) override { Scope scope(this); m_consumer->HandleTopLevelDeclInObjCContainer(decls); }
+    virtual void HandleImplicitImportDecl(ImportDecl* decl) override { Scope scope(this); m_consumer->HandleImplicitImportDecl(decl); }
+    virtual void CompleteTentativeDefinition(VarDecl* decl) override { Scope scope(this); m_consumer->CompleteTentativeDefinition(decl); }
+    virtual void CompleteExternalDeclaration(VarDecl* decl) override { Scope scope(this); m_consumer->CompleteExternalDeclaration(decl); }
+    virtual void AssignInheritanceModel(CXXRecordDecl* decl) override { Scope scope(this); m_consumer->AssignInheritanceModel(decl); }
+    virtual void HandleCXXStaticMemberVarInstantiation(VarDecl* decl) override { Scope scope(this); m_consumer->HandleCXXStaticMemberVarInstantiation(decl); }
+    virtual void HandleVTable(CXXRecordDecl* decl) override { Scope scope(this); m_consumer->HandleVTable(decl); }
+    virtual ASTMutationListener* GetASTMutationListener() override { return m_consumer->GetASTMutationListener(); }
+    virtual ASTDeserializationListener* GetASTDeserializationListener() override { return m_consumer->GetASTDeserializationListener(); }
+    virtual void PrintStats() override { m_consumer->PrintStats(); }
+    virtual bool shouldSkipFunctionBody(Decl* decl) override { return m_consumer->shouldSkipFunctionBody(decl); }
+
+    IRGenTimingConsumer(std::unique_ptr<ASTConsumer> consumer, SlangLLVMPhaseTime& ioTime) :
+        m_consumer(std::move(consumer)),
+        m_time(ioTime)
+    {
+    }
+
+protected:
+    struct Scope
+    {
+        Scope(IRGenTimingConsumer* owner) : m_owner(owner)
+        {
+            if (m_owner->m_depth++ == 0)
+            {
+                m_timer.emplace(m_owner->m_time);
+            }
+        }
+        ~Scope() { m_owner->m_depth--; }
+
+        IRGenTimingConsumer* m_owner;
+        llvm::Optional<PhaseTimer> m_timer;
+    };
+
+    std::unique_ptr<ASTConsumer> m_consumer;
+    SlangLLVMPhaseTime& m_time;
+    int m_depth = 0;
+};
+
+/* Produces a module, in the same way as EmitLLVMOnlyAction, timing the IR generation */
+class TimedEmitLLVMOnlyAction : public EmitLLVMOnlyAction
+{
+public:
+    TimedEmitLLVMOnlyAction(LLVMContext* context, SlangLLVMPhaseTime& ioIRGenTime) :
+        EmitLLVMOnlyAction(context),
+        m_irGenTime(ioIRGenTime)
+    {
+    }
+
+protected:
+    virtual std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& compiler, StringRef inFile) override
+    {
+        auto consumer = EmitLLVMOnlyAction::CreateASTConsumer(compiler, inFile);
+        return consumer ? std::make_unique<IRGenTimingConsumer>(std::move(consumer), m_irGenTime) : nullptr;
+    }
+
+    SlangLLVMPhaseTime& m_irGenTime;
+};
+
+/* Compile the source into a module. Problems with the source are reported to diagnostics (with the result set to
+failed) and outModule is not set. A failure is only returned if the compilation could not be performed.
+
+The time spent generating IR is added to ioIRGenTime. */
+static SlangResult _compileSource(const DownstreamCompileOptions& options, const OptimizationProfile& profile, StringRef sourceStringRef, IArtifactDiagnostics* diagnostics, SlangLLVMPhaseTime& ioIRGenTime, ThreadSafeModule& outModule)
+{
+    std::unique_ptr<CompilerInstance> clang(new CompilerInstance());
+    IntrusiveRefCntPtr<DiagnosticIDs> diagID(new DiagnosticIDs());
+
+    // Register the support for object-file-wrapped Clang modules.
+    auto pchOps = clang->getPCHContainerOperations();
+    pchOps->registerWriter(std::make_unique<ObjectFilePCHContainerWriter>());
+    pchOps->registerReader(std::make_unique<ObjectFilePCHContainerReader>());
+
+    IntrusiveRefCntPtr<DiagnosticOptions> diagOpts = new DiagnosticOptions();
+
+    // TODO(JS): We might just want this to talk directly to the listener.
+    // For now we just buffer up. 
+    BufferedDiagnosticConsumer diagsBuffer(diagnostics);
+
+    IntrusiveRefCntPtr<DiagnosticsEngine> diags = new DiagnosticsEngine(diagID, diagOpts, &diagsBuffer, false);
+
+    auto& invocation = clang->getInvocation();
+
+    std::string verboseOutputString;
+
+    // Capture all of the verbose output into a buffer, so not writen to stdout
+    clang->setVerboseOutputStream(std::make_unique<llvm::raw_string_ostream>(verboseOutputString));
+
+    SmallVector<char> output;
+    clang->setOutputStream(std::make_unique<llvm::raw_svector_ostream>(output));
+
+    frontend::ActionKind action = frontend::ActionKind::EmitLLVMOnly;
+
+    // EmitCodeGenOnly doesn't appear to actually emit anything
+    // EmitLLVM outputs LLVM assembly
+    // EmitLLVMOnly doesn't 'emit' anything, but the IR that is produced is accessible, from the 'action'.
+
+    action = frontend::ActionKind::EmitLLVMOnly;
+
+    //action = frontend::ActionKind::EmitBC;
+    //action = frontend::ActionKind::EmitLLVM;
+    // 
+    //action = frontend::ActionKind::EmitCodeGenOnly;
+    //action = frontend::ActionKind::EmitObj;
+    //action = frontend::ActionKind::EmitAssembly;
+
+    InputKind inputKind;
+    SLANG_RETURN_ON_FAIL(_initInvocation(options, profile, invocation, inputKind));
+
+    // If the source starts with the prelude, we can use a precompiled header instead of parsing the prelude.
+    // The rest of the source starts with a #line, so locations are the same as when the prelude is parsed.
+    std::string sourceAfterPrelude;
+    {
+        std::string pchPath;
+        size_t preludeSize = 0;
+        if (SLANG_SUCCEEDED(PreludePCHCache::getSingleton().findPCH(options, profile, sourceStringRef, _buildPrecompiledHeader, pchPath, preludeSize)))
+        {
+            invocation.getPreprocessorOpts().ImplicitPCHInclude = pchPath;
+
+            const size_t preludeLineCount = size_t(sourceStringRef.substr(0, preludeSize).count('\n'));
+            sourceAfterPrelude = "#line " + std::to_string(preludeLineCount + 1) + "\n";
+            sourceAfterPrelude += sourceStringRef.substr(preludeSize).str();
+
+            sourceStringRef = sourceAfterPrelude;
+        }
     }
 
+    auto sourceBuffer = llvm::MemoryBuffer::getMemBuffer(sourceStringRef);
 
     {
-        auto& opts = invocation.getCodeGenOpts();
+        auto& opts = invocation.getFrontendOpts();
 
-        // Set to -O optimization level
-        opts.OptimizationLevel = _getOptimizationLevel(options.optimizationLevel);
+        // Add the source
+        // TODO(JS): For the moment this kind of include does *NOT* show a input source filename
+        // not super surprising as one isn't set, but it's not clear how one would be set when the input is a memory buffer.
+        // For Slang usage, this probably isn't an issue, because it's *output* typically holds #line directives.
+        {
+            
+            FrontendInputFile inputFile(*sourceBuffer, inputKind);
+            opts.Inputs.push_back(inputFile);
+        }
 
-        // Copy over the targets CodeModel
-        opts.CodeModel = invocation.getTargetOpts().CodeModel;
+        opts.ProgramAction = action;
     }
 
     //const llvm::opt::OptTable& opts = clang::driver::getDriverOptTable();
@@ -829,7 +1917,7 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
         // If we are going to just emit IR, we need to have access to the underlying type
         if (action == frontend::ActionKind::EmitLLVMOnly)
         {
-            EmitLLVMOnlyAction* llvmOnlyAction = new EmitLLVMOnlyAction(llvmContext.get());
+            EmitLLVMOnlyAction* llvmOnlyAction = new TimedEmitLLVMOnlyAction(llvmContext.get(), ioIRGenTime);
             codeGenAction = llvmOnlyAction;
             // Make act the owning ptr
             act = std::unique_ptr<FrontendAction>(llvmOnlyAction);
@@ -844,7 +1932,11 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
             return SLANG_FAIL;
         }
 
-        const bool compileSucceeded = clang->ExecuteAction(*act);
+        bool compileSucceeded = false;
+        {
+            llvm::TimeTraceScope timeScope("ExecuteAction");
+            compileSucceeded = clang->ExecuteAction(*act);
+        }
 
         // If the compilation failed make sure, we have an error
         if (!compileSucceeded)
@@ -855,11 +1947,6 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
         if (!compileSucceeded || diagsBuffer.hasError())
         {
             diagnostics->setResult(SLANG_FAIL);
-
-            auto artifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::None, ArtifactPayload::None));
-            ArtifactUtil::addAssociated(artifact, diagnostics);
-
-            *outArtifact = artifact.detach();
             return SLANG_OK;
         }
     }
@@ -901,158 +1988,553 @@ SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IAr
         }
     }
 
-    switch (options.targetType)
+    if (!module)
     {
-        // TODO(JS): Shared library may not be appropriate, but as long as the 'shared library' is never accessed as a blob
-        // all is good.
-        case SLANG_SHADER_SHARED_LIBRARY:
+        return SLANG_FAIL;
+    }
 
-        // TODO(JS):
-        // Hmm. What does this even mean?
-        // I guess the idea is it's 'SHADER' style, but is runnable on the host. 
-        case SLANG_SHADER_HOST_CALLABLE:
-        {
-            // Try running something in the module on the JIT
-            std::unique_ptr<llvm::orc::LLJIT> jit;
-            {
-                // Create the JIT
+    outModule = ThreadSafeModule(std::move(module), std::move(llvmContext));
+    return SLANG_OK;
+}
+
+/* Compile a single unit, using the object cache if possible. The unit's result and diagnostics are set (diagnostics are
+created if the unit doesn't have them), so this can be run on any thread. */
+static void _compileTranslationUnit(const DownstreamCompileOptions& options, const LLVMCompileOptions& llvmOptions, bool isJITTarget, TranslationUnit& unit)
+{
+    auto& phases = unit.metrics.phases;
+    PhaseTimer totalTimer(phases[SLANG_LLVM_COMPILE_PHASE_TOTAL]);
 
-                LLJITBuilder jitBuilder;
+    if (!unit.diagnostics)
+    {
+        unit.diagnostics = new ArtifactDiagnostics;
+    }
 
-                Expected<std::unique_ptr< llvm::orc::LLJIT>> expectJit = jitBuilder.create();
-                if (!expectJit)
-                {
-                    /* JS: NOTE!
-                    
-                    It is worth saying there can be some odd issues around creating the JIT - if LLVM-C is linked against.
-                    
-                    If it is then LLVM will likely startup saying LLVM-C isn't found.
-                    BUT if you have LLVM *installed* on your system (as is reasonable to do from a LLVM distro, then
-                    at startup it *MIGHT* find a LLVM-C dll in that installation (ie nothing to do with the version of LLVM
-                    linked with). This will likely lead to an odd error saying the 'triple can't be found' and that no
-                    targets are registered.
+    // If there is an object in the disk cache, we can skip the frontend and code generation.
+    // Lazily compiled modules are split up by the JIT, so there is no single object to cache. Tiered modules are
+    // compiled twice, and tier 1 depends on tier 0, so aren't cached either. Counted functions are only known from the
+    // module, and neither are the counters that collect a profile.
+    if (isJITTarget && !llvmOptions.lazy && !llvmOptions.tiered && unit.countersName.empty() && unit.pgoCountersName.empty())
+    {
+        unit.objectKey = DiskObjectCache::calcKey(unit.cacheKey);
+
+        // Only the generation of the profile used is part of the key, which is specific to this process, so objects
+        // optimized with a profile are captured for the compile cache but not stored
+        unit.isObjectStored = unit.profileKey.empty() && DiskObjectCache::getSingleton().isEnabled();
+
+        if (auto object = unit.isObjectStored ? DiskObjectCache::getSingleton().load(unit.objectKey) : nullptr)
+        {
+            unit.object = std::move(object);
+            unit.metrics.objectCacheHitCount = 1;
+            return;
+        }
+    }
 
-                    Also note that the behavior *may* be different with Debug/Release - because of how the linked resolves symbols
-                    that are multiply defined.
+    if (_isIRForm(unit.form))
+    {
+        // IR is parsed directly, without the clang frontend
+        PhaseTimer timer(phases[SLANG_LLVM_COMPILE_PHASE_FRONTEND]);
 
-                    If there are problems creating the JIT, check that LLVM-C is not linked against (it should be disabled in the premake).
-                    */
+        auto context = std::make_unique<LLVMContext>();
+        if (auto module = _parseIR(unit.sourceBlob, *context, unit.diagnostics))
+        {
+            unit.module = ThreadSafeModule(std::move(module), std::move(context));
+        }
+    }
+    else
+    {
+        const auto sourceSlice = StringUtil::getSlice(unit.sourceBlob);
+        const StringRef sourceStringRef(sourceSlice.begin(), sourceSlice.getLength());
 
-                    auto err = expectJit.takeError();
+        SlangLLVMPhaseTime sourceTime = {};
+        {
+            PhaseTimer timer(sourceTime);
+            unit.result = _compileSource(options, llvmOptions.profile, sourceStringRef, unit.diagnostics, phases[SLANG_LLVM_COMPILE_PHASE_IRGEN], unit.module);
+        }
 
-                    std::string jitErrorString;
-                    llvm::raw_string_ostream jitErrorStream(jitErrorString);
+        // The frontend is whatever isn't IR generation
+        auto& frontendTime = phases[SLANG_LLVM_COMPILE_PHASE_FRONTEND];
+        frontendTime.wallSeconds = sourceTime.wallSeconds - phases[SLANG_LLVM_COMPILE_PHASE_IRGEN].wallSeconds;
+        frontendTime.cpuSeconds = sourceTime.cpuSeconds - phases[SLANG_LLVM_COMPILE_PHASE_IRGEN].cpuSeconds;
+    }
 
-                    jitErrorStream << err;
+    if (SLANG_FAILED(unit.result) || !unit.module)
+    {
+        return;
+    }
 
-                    ArtifactDiagnostic diagnostic;
+    unit.module.withModuleDo([&](llvm::Module& module)
+    {
+        addModuleCounts(module, unit.metrics.beforeOptimization);
 
-                    StringBuilder buf;
-                    buf << "Unable to create JIT engine: " << jitErrorString.c_str();
+        // Profiles are collected and applied before optimization, so they can guide it. The module is the same in
+        // both phases at this point.
+        if (!unit.pgoCountersName.empty())
+        {
+            instrumentModuleForPGO(module, unit.pgoCountersName, unit.pgoLayout);
+        }
+        else if (unit.pgoProfile)
+        {
+            // Functions whose control flow differs from when the profile was collected are skipped
+            if (applyPGOProfileToModule(module, *unit.pgoProfile) == 0)
+            {
+                _addWarning("The profile found for source doesn't match any of its functions, compiling without it", unit.diagnostics);
+            }
+        }
 
-                    diagnostic.severity = ArtifactDiagnostic::Severity::Error;
-                    diagnostic.stage = ArtifactDiagnostic::Stage::Link;
-                    diagnostic.text = TerminatedCharSlice(buf.getBuffer(), buf.getLength());
-                    
-                    // Add the error
-                    diagnostics->add(diagnostic);
-                    diagnostics->setResult(SLANG_FAIL);
+        PhaseTimer optimizeTimer(phases[SLANG_LLVM_COMPILE_PHASE_OPTIMIZE]);
 
-                    auto artifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::None, ArtifactPayload::None));
-                    ArtifactUtil::addAssociated(artifact, diagnostics);
+        if (isJITTarget && llvmOptions.tiered)
+        {
+            // Tiering makes some symbols visible that shouldn't be exported
+            _addExportedNames(module, unit.exportedNames);
 
-                    *outArtifact = artifact.detach();
-                    return SLANG_OK;
-                }
-                jit = std::move(*expectJit);
+            // Keep a copy of the unoptimized module for tier 1, which is compiled in another context on another thread.
+            // The JIT'd code is unoptimized.
+            prepareModuleForTiering(module);
+            {
+                llvm::raw_string_ostream stream(unit.tier1Bitcode);
+                llvm::WriteBitcodeToFile(module, stream);
             }
 
-            // Used the following link to test this out
-            // https://www.llvm.org/docs/ORCv2.html
-            // https://www.llvm.org/docs/ORCv2.html#processandlibrarysymbols
+            optimizeModule(OptimizationProfile::getForLevel(0, 0), module, unit.diagnostics);
+            markModuleForTier0(module);
+        }
+        else
+        {
+            // Problems are reported through the diagnostics
+            optimizeModule(llvmOptions.profile, module, unit.diagnostics);
 
+            // After optimization, as unused inline functions may have been removed
+            if (isJITTarget)
             {
-                auto& es = jit->getExecutionSession();
+                _addExportedNames(module, unit.exportedNames);
+            }
+        }
 
-                const DataLayout& dl = jit->getDataLayout();
-                MangleAndInterner mangler(es, dl);
+        optimizeTimer.stop();
+        addModuleCounts(module, unit.metrics.afterOptimization);
 
-                // The name of the lib must be unique. Should be here as we are only thing adding libs
-                auto stdcLibExpected = es.createJITDylib("stdc");
+        if (!unit.countersName.empty())
+        {
+            instrumentModuleWithCounters(module, unit.countersName, llvmOptions.cycleCounters, unit.counterNames);
+        }
 
-                if (stdcLibExpected)
-                {
-                    auto& stdcLib = *stdcLibExpected;
+        // Identify the module, such that the object produced can be captured (and stored if the object cache is enabled)
+        if (!unit.objectKey.empty())
+        {
+            module.setModuleIdentifier(DiskObjectCache::getModuleIdentifier(unit.objectKey, unit.isObjectStored));
+        }
+    });
+}
 
-                    // Add all the symbolmap
-                    SymbolMap symbolMap;
+// Associate the metrics with the artifact, as the representation of an associated artifact
+static void _addAssociatedMetrics(IArtifact* artifact, ISlangLLVMCompileMetrics* metrics)
+{
+    auto metricsArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Instance, ArtifactPayload::Metadata));
+    metricsArtifact->addRepresentation(metrics);
 
-                    //symbolMap.insert(std::make_pair(mangler("sin"), JITEvaluatedSymbol::fromPointer(static_cast<double (*)(double)>(&sin))));
+    artifact->addAssociated(metricsArtifact);
+}
 
-                    {
-                        static const NameAndFunc funcs[] =
-                        {
-                            SLANG_LLVM_FUNCS(SLANG_LLVM_FUNC)
-                            SLANG_PLATFORM_FUNCS(SLANG_LLVM_FUNC)
-                        };
+// Associate the time trace JSON with the artifact
+static void _addAssociatedTimeTrace(IArtifact* artifact, const std::string& json)
+{
+    auto traceArtifact = ArtifactUtil::createArtifact(ArtifactDesc::make(ArtifactKind::Json, ArtifactPayload::Unknown));
+    traceArtifact->addRepresentationUnknown(RawBlob::create(json.data(), json.size()));
 
-                        for (auto& func : funcs)
-                        {
-                            symbolMap.insert(std::make_pair(mangler(func.name), JITEvaluatedSymbol::fromPointer(func.func)));
-                        }
-                    }
+    artifact->addAssociated(traceArtifact);
+}
 
-#if SLANG_PTR_IS_32 && SLANG_VC
-                    {
-                        // https://docs.microsoft.com/en-us/windows/win32/devnotes/-win32-alldiv
-                        symbolMap.insert(std::make_pair(mangler("_alldiv"), JITEvaluatedSymbol::fromPointer(WinSpecific::_alldiv)));
-                        symbolMap.insert(std::make_pair(mangler("_allrem"), JITEvaluatedSymbol::fromPointer(WinSpecific::_allrem)));
-                        symbolMap.insert(std::make_pair(mangler("_aullrem"), JITEvaluatedSymbol::fromPointer(WinSpecific::_aullrem)));
-                        symbolMap.insert(std::make_pair(mangler("_aulldiv"), JITEvaluatedSymbol::fromPointer(WinSpecific::_aulldiv)));
-                    }
-#endif
+/* Compile the sources of options, outputting an artifact (which may only hold diagnostics). Metrics are added to
+ioMetrics. Of the total time, only the CPU time of units compiled on other threads is added. If timeTrace is started,
+units compiled on other threads are also traced. */
+static SlangResult _compile(const DownstreamCompileOptions& options, const LLVMCompileOptions& llvmOptions, bool isJITTarget, const TimeTrace* timeTrace, IArtifactDiagnostics* diagnostics, SlangLLVMCompileMetrics& ioMetrics, IArtifact** outArtifact)
+{
+    const Count sourceCount = options.sourceArtifacts.count;
 
-                    if (auto err = stdcLib.define(absoluteSymbols(symbolMap)))
-                    {
-                        return SLANG_FAIL;
-                    }
+    std::vector<TranslationUnit> units(sourceCount);
+    std::vector<std::string> unitKeys;
+    for (Index i = 0; i < sourceCount; ++i)
+    {
+        auto& unit = units[i];
+        IArtifact* sourceArtifact = options.sourceArtifacts[i];
 
-                    // Required or the symbols won't be found
-                    jit->getMainJITDylib().addToLinkOrder(stdcLib);
-                }
-            }
+        SLANG_RETURN_ON_FAIL(sourceArtifact->loadBlob(ArtifactKeep::Yes, unit.sourceBlob.writeRef()));
+
+        // Sources can be LLVM IR (textual or bitcode). Anything else is treated as source in options.sourceLanguage.
+        const auto sourceForm = _getPipelineForm(sourceArtifact->getDesc());
+        if (_isIRForm(sourceForm))
+        {
+            unit.form = sourceForm;
+        }
 
-            ThreadSafeModule threadSafeModule(std::move(module), std::move(llvmContext));
+        unit.cacheKey = CompileCache::calcKey(options, unit.sourceBlob);
+
+        // Each unit has its own counters, as the units are compiled independently
+        if (isJITTarget && llvmOptions.counters)
+        {
+            unit.countersName = "__slang_llvm_counters." + std::to_string(i);
+        }
 
-            if (auto err = jit->addIRModule(std::move(threadSafeModule)))
+        if (isJITTarget && llvmOptions.pgoGenerate)
+        {
+            unit.profileKey = PGOProfileStore::calcKey(options, unit.sourceBlob);
+            unit.pgoCountersName = "__slang_llvm_pgo_counters." + std::to_string(i);
+        }
+        else if (llvmOptions.pgoUse)
+        {
+            unit.profileKey = PGOProfileStore::calcKey(options, unit.sourceBlob);
+            unit.pgoProfile = PGOProfileStore::getSingleton().find(unit.profileKey);
+            if (unit.pgoProfile)
             {
-                return SLANG_FAIL;
+                // The code depends on the profile
+                unit.cacheKey += "-profile-" + std::to_string(unit.pgoProfile->generation);
             }
-
-            if (auto err = jit->initialize(jit->getMainJITDylib()))
+            else
             {
-                return SLANG_FAIL;
+                _addWarning("No profile found for source (see -jit-pgo-generate), compiling without one", diagnostics);
             }
+        }
 
-            // Create the shared library
-            ComPtr<ISlangSharedLibrary> sharedLibrary(new LLVMJITSharedLibrary(std::move(jit)));
+        unitKeys.push_back(unit.cacheKey);
+    }
+
+    // The JIT'd targets can be satisfied from the compile cache
+    const std::string cacheKey = CompileCache::combineKeys(unitKeys);
+    if (isJITTarget && _isCompileCacheable(llvmOptions))
+    {
+        CompileCache::Entry entry;
+        if (CompileCache::getSingleton().find(cacheKey, entry))
+        {
+            ioMetrics.isCompileCacheHit = true;
+
+            PhaseTimer codeGenTimer(ioMetrics.phases[SLANG_LLVM_COMPILE_PHASE_CODEGEN]);
+            return _createJITArtifactFromCache(options, llvmOptions, entry, outArtifact);
+        }
+    }
+
+    if (units.size() == 1)
+    {
+        _compileTranslationUnit(options, llvmOptions, isJITTarget, units[0]);
+    }
+    else
+    {
+        // Each unit has its own CompilerInstance and LLVMContext, so they can be compiled in parallel.
+        // Use a thread per unit, up to the number of cores.
+        ThreadPoolStrategy strategy = heavyweight_hardware_concurrency(unsigned(units.size()));
+        strategy.Limit = true;
+
+        llvm::ThreadPool threadPool(strategy);
+        for (auto& unit : units)
+        {
+            TranslationUnit* unitPtr = &unit;
+            threadPool.async([&options, &llvmOptions, isJITTarget, timeTrace, unitPtr]()
+            {
+                TimeTraceThreadScope timeTraceScope(timeTrace);
+                _compileTranslationUnit(options, llvmOptions, isJITTarget, *unitPtr);
+            });
+        }
+        threadPool.wait();
+
+        for (const auto& unit : units)
+        {
+            ioMetrics.phases[SLANG_LLVM_COMPILE_PHASE_TOTAL].cpuSeconds += unit.metrics.phases[SLANG_LLVM_COMPILE_PHASE_TOTAL].cpuSeconds;
+        }
+    }
+
+    // Merge the diagnostics, in the order of the source artifacts
+    for (auto& unit : units)
+    {
+        SLANG_RETURN_ON_FAIL(unit.result);
+
+        addUnitMetrics(unit.metrics, ioMetrics);
+
+        const Count count = unit.diagnostics->getCount();
+        for (Index i = 0; i < count; ++i)
+        {
+            diagnostics->add(*unit.diagnostics->getAt(i));
+        }
+        if (SLANG_FAILED(unit.diagnostics->getResult()))
+        {
+            diagnostics->setResult(unit.diagnostics->getResult());
+        }
+    }
+
+    if (SLANG_FAILED(diagnostics->getResult()))
+    {
+        _createDiagnosticsArtifact(diagnostics, outArtifact);
+        return SLANG_OK;
+    }
 
-            // Work out the ArtifactDesc 
-            const auto targetDesc = ArtifactDescUtil::makeDescForCompileTarget(options.targetType);
+    PhaseTimer codeGenTimer(ioMetrics.phases[SLANG_LLVM_COMPILE_PHASE_CODEGEN]);
 
-            auto artifact = ArtifactUtil::createArtifact(targetDesc);
-            ArtifactUtil::addAssociated(artifact, diagnostics);
+    if (isJITTarget)
+    {
+        return _createJITArtifact(options, llvmOptions, cacheKey, units, diagnostics, outArtifact);
+    }
 
-            artifact->addRepresentation(sharedLibrary);
+    if (options.targetType == SLANG_OBJECT_CODE)
+    {
+        ComPtr<ISlangBlob> blob;
+        SlangResult res = SLANG_FAIL;
+        units[0].module.withModuleDo([&](llvm::Module& module) { res = _emitModule(module, PipelineForm::ObjectCode, diagnostics, blob); });
 
-            *outArtifact = artifact.detach();
+        if (SLANG_FAILED(res))
+        {
+            diagnostics->setResult(res);
+            _createDiagnosticsArtifact(diagnostics, outArtifact);
             return SLANG_OK;
         }
+
+        _createBlobArtifact(ArtifactDescUtil::makeDescForCompileTarget(options.targetType), blob, diagnostics, outArtifact);
+        return SLANG_OK;
     }
 
     return SLANG_FAIL;
 }
 
+SlangResult LLVMDownstreamCompiler::compile(const CompileOptions& inOptions, IArtifact** outArtifact)
+{
+    if (!isVersionCompatible(inOptions))
+    {
+        // Not possible to compile with this version of the interface.
+        return SLANG_E_NOT_IMPLEMENTED;
+    }
+
+    CompileOptions options = getCompatibleVersion(&inOptions);
+
+    SlangLLVMCompileMetrics metrics = {};
+    PhaseTimer totalTimer(metrics.phases[SLANG_LLVM_COMPILE_PHASE_TOTAL]);
+
+    // TODO(JS): Shared library may not be appropriate, but as long as the 'shared library' is never accessed as a blob
+    // all is good.
+    //
+    // TODO(JS):
+    // Hmm. What does host callable even mean?
+    // I guess the idea is it's 'SHADER' style, but is runnable on the host. 
+    const bool isJITTarget = options.targetType == SLANG_SHADER_HOST_CALLABLE || options.targetType == SLANG_SHADER_SHARED_LIBRARY;
+
+    // Multiple sources are linked by loading them all into the JIT, so other targets only support a single source
+    const Count sourceCount = options.sourceArtifacts.count;
+    if (sourceCount <= 0 || (sourceCount != 1 && !isJITTarget))
+    {
+        return SLANG_FAIL;
+    }
+
+    _ensureSufficientStack();
+
+    SLANG_RETURN_ON_FAIL(initLLVM());
+
+    ComPtr<IArtifactDiagnostics> diagnostics(new ArtifactDiagnostics);
+
+    LLVMCompileOptions llvmOptions;
+    if (SLANG_FAILED(llvmOptions.parse(options, diagnostics)))
+    {
+        _createDiagnosticsArtifact(diagnostics, outArtifact);
+        return SLANG_OK;
+    }
+
+    // Tiering uses stubs, which need the same target support as lazy compilation
+    if (isJITTarget && llvmOptions.tiered)
+    {
+        std::shared_ptr<JITSession> session;
+        std::string errorString;
+        if (SLANG_SUCCEEDED(JITSession::get(session, errorString)) && !session->isLazySupported())
+        {
+            _addWarning("Tiered compilation is not supported on this target, compiling once", diagnostics);
+            llvmOptions.tiered = false;
+        }
+    }
+
+    StatisticsSnapshot statisticsBefore;
+    if (llvmOptions.statistics)
+    {
+        // Without printing them on exit. Once enabled, statistics are collected for the rest of the process.
+        llvm::EnableStatistics(false);
+        statisticsBefore.capture();
+    }
+
+    // If a directory is set, all compilations are traced. Only one compilation can be traced at a time, so unless the
+    // trace was asked for with -time-trace a compilation isn't held up waiting for another trace, it just isn't traced.
+    TimeTrace timeTrace;
+    if (llvmOptions.timeTrace || TimeTrace::hasDirectory())
+    {
+        const SlangResult traceResult = timeTrace.start(llvmOptions.timeTraceGranularity, llvmOptions.timeTrace);
+        if (traceResult == SLANG_E_TIME_OUT)
+        {
+            _addWarning("Not producing a time trace, as another compilation is being traced", diagnostics);
+        }
+        else if (SLANG_FAILED(traceResult))
+        {
+            _addWarning("Unable to produce a time trace, as the thread is already being traced", diagnostics);
+        }
+    }
+
+    ComPtr<IArtifact> artifact;
+    {
+        llvm::TimeTraceScope timeScope("Compile");
+        SLANG_RETURN_ON_FAIL(_compile(options, llvmOptions, isJITTarget, &timeTrace, diagnostics, metrics, artifact.writeRef()));
+    }
+
+    totalTimer.stop();
+
+    if (timeTrace.isStarted())
+    {
+        std::string json;
+        timeTrace.stop(json);
+
+        if (SLANG_FAILED(TimeTrace::writeToDirectory(json)))
+        {
+            _addWarning("Unable to write time trace", diagnostics);
+        }
+        if (llvmOptions.timeTrace)
+        {
+            _addAssociatedTimeTrace(artifact, json);
+        }
+    }
+
+    StatisticsSnapshot::Values statistics;
+    if (llvmOptions.statistics)
+    {
+        StatisticsSnapshot statisticsAfter;
+        statisticsAfter.capture();
+        statistics = statisticsAfter.getChangesSince(statisticsBefore);
+    }
+
+    ComPtr<ISlangLLVMCompileMetrics> compileMetrics(new CompileMetrics(metrics, std::move(statistics)));
+    _addAssociatedMetrics(artifact, compileMetrics);
+
+    *outArtifact = artifact.detach();
+    return SLANG_OK;
+}
+
+bool LLVMDownstreamCompiler::canConvert(const ArtifactDesc& from, const ArtifactDesc& to)
+{
+    const auto fromForm = _getPipelineForm(from);
+    const auto toForm = _getPipelineForm(to);
+
+    if (fromForm == PipelineForm::Unknown || toForm == PipelineForm::Unknown)
+    {
+        return false;
+    }
+
+    // IR and bitcode are just different representations of a module
+    if (_isIRForm(fromForm) && _isIRForm(toForm))
+    {
+        return fromForm != toForm;
+    }
+
+    // Otherwise we can only go forward through the pipeline. Object code can only be JIT'd.
+    return fromForm < toForm;
+}
+
+SlangResult LLVMDownstreamCompiler::convert(IArtifact* from, const ArtifactDesc& to, IArtifact** outArtifact)
+{
+    if (!canConvert(from->getDesc(), to))
+    {
+        return SLANG_FAIL;
+    }
+
+    SLANG_RETURN_ON_FAIL(initLLVM());
+
+    const auto fromDesc = from->getDesc();
+    const auto fromForm = _getPipelineForm(fromDesc);
+    const auto toForm = _getPipelineForm(to);
+
+    // There are no options for a conversion, so we use the defaults. The target is whatever to describes, so a
+    // conversion to a shared library produces a shared library. (IR forms aren't compile targets, and are unknown.)
+    CompileOptions options;
+    options.sourceLanguage = (fromDesc.payload == ArtifactPayload::C) ? SLANG_SOURCE_LANGUAGE_C : SLANG_SOURCE_LANGUAGE_CPP;
+    options.targetType = ArtifactDescUtil::getCompileTargetFromDesc(to);
+
+    LLVMCompileOptions llvmOptions;
+
+    ComPtr<IArtifactDiagnostics> diagnostics(new ArtifactDiagnostics);
+
+    std::vector<TranslationUnit> units(1);
+    auto& unit = units[0];
+    unit.diagnostics = diagnostics;
+
+    SLANG_RETURN_ON_FAIL(from->loadBlob(ArtifactKeep::No, unit.sourceBlob.writeRef()));
+
+    // Source languages are part of the key, so the key for IR or object code doesn't match the same bytes as source
+    if (fromForm != PipelineForm::Source)
+    {
+        options.sourceLanguage = SLANG_SOURCE_LANGUAGE_UNKNOWN;
+    }
+    // The options are made up, so the key is salted, such that a conversion never shares a compile cache (or object
+    // cache) entry with a compilation whose options happen to match
+    unit.cacheKey = "convert-" + CompileCache::calcKey(options, unit.sourceBlob);
+
+    if (toForm == PipelineForm::HostCallable)
+    {
+        CompileCache::Entry entry;
+        if (CompileCache::getSingleton().find(unit.cacheKey, entry))
+        {
+            return _createJITArtifactFromCache(options, llvmOptions, entry, outArtifact);
+        }
+    }
+
+    switch (fromForm)
+    {
+        case PipelineForm::Source:
+        case PipelineForm::LLVMIR:
+        case PipelineForm::LLVMBitcode:
+        {
+            unit.form = fromForm;
+
+            if (_isIRForm(fromForm) && _isIRForm(toForm))
+            {
+                // Converting between IR representations doesn't change (or optimize) the module
+                auto context = std::make_unique<LLVMContext>();
+                if (auto module = _parseIR(unit.sourceBlob, *context, diagnostics))
+                {
+                    unit.module = ThreadSafeModule(std::move(module), std::move(context));
+                }
+            }
+            else
+            {
+                _compileTranslationUnit(options, llvmOptions, toForm == PipelineForm::HostCallable, unit);
+                SLANG_RETURN_ON_FAIL(unit.result);
+            }
+            break;
+        }
+        case PipelineForm::ObjectCode:
+        {
+            const auto slice = StringUtil::getSlice(unit.sourceBlob);
+            unit.object = llvm::MemoryBuffer::getMemBufferCopy(StringRef(slice.begin(), slice.getLength()));
+            break;
+        }
+        default: return SLANG_FAIL;
+    }
+
+    // As with compile, failures reported in the diagnostics produce an artifact that holds them
+    if (SLANG_FAILED(diagnostics->getResult()))
+    {
+        _createDiagnosticsArtifact(diagnostics, outArtifact);
+        return SLANG_OK;
+    }
+
+    if (toForm == PipelineForm::HostCallable)
+    {
+        // On failure the artifact only holds diagnostics
+        return _createJITArtifact(options, llvmOptions, unit.cacheKey, units, diagnostics, outArtifact);
+    }
+
+    ComPtr<ISlangBlob> blob;
+    SlangResult res = SLANG_FAIL;
+    unit.module.withModuleDo([&](llvm::Module& module) { res = _emitModule(module, toForm, diagnostics, blob); });
+    if (SLANG_FAILED(res))
+    {
+        diagnostics->setResult(res);
+        _createDiagnosticsArtifact(diagnostics, outArtifact);
+        return SLANG_OK;
+    }
+
+    _createBlobArtifact(to, blob, diagnostics, outArtifact);
+    return SLANG_OK;
+}
+
 } // namespace slang_llvm
 
 extern "C" SLANG_DLL_EXPORT SlangResult createLLVMDownstreamCompiler_V4(const SlangUUID& intfGuid, Slang::IDownstreamCompiler** out)
@@ -0,0 +1,292 @@
+#ifndef SLANG_LLVM_H
+#define SLANG_LLVM_H
+
+#include <slang.h>
+
+#include <compiler-core/slang-downstream-compiler.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Functions exported from the slang-llvm shared library in addition to `createLLVMDownstreamCompiler_V4`.
+
+Slang itself only ever uses `createLLVMDownstreamCompiler_V4`. The functions here allow an application that
+loads slang-llvm (or finds it via the shared library Slang has loaded) to configure and query process wide
+state. As with `createLLVMDownstreamCompiler_V4` they are typically looked up by name, so a function pointer
+typedef is provided for each. */
+
+/* The shared library of a host callable (or shared library) artifact produced by slang-llvm, in addition to
+ISlangSharedLibrary. Obtained by using castAs (or queryInterface) on the artifact's ISlangSharedLibrary.
+
+Addresses found are cached by the library, so repeated lookups of the same name are cheap. */
+struct ISlangLLVMJITSharedLibrary : public ISlangSharedLibrary
+{
+    SLANG_COM_INTERFACE(0x8ff503df, 0xec83, 0x46ac, { 0xb5, 0x06, 0x80, 0x46, 0x61, 0x19, 0x12, 0xef })
+
+        /// Find the addresses of count symbols, writing them to outAddresses. Symbols not found have a nullptr address.
+        /// Symbols that haven't been looked up before are looked up in a single query, which is faster than looking
+        /// them up individually. Returns SLANG_E_NOT_FOUND if any symbol wasn't found.
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL findSymbolAddressesByName(const char* const* names, size_t count, void** outAddresses) = 0;
+
+        /// The number of symbols the library exports
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getExportedSymbolCount() = 0;
+        /// Get the name of an exported symbol, index is from 0 to getExportedSymbolCount() - 1. Names are sorted.
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getExportedSymbolName(size_t index) = 0;
+};
+
+/// The counters of a function JIT'd with -jit-counters
+struct SlangLLVMFunctionCounters
+{
+    uint64_t callCount;
+    uint64_t cycleCount;            ///< Cycles from entry to return, including callees. Only counted with -jit-cycle-counters.
+};
+
+/* The counters of a library compiled with -jit-counters (or -jit-cycle-counters). Obtained by using castAs on the
+library's ISlangSharedLibrary.
+
+Every function in the JIT'd code is counted, including internal functions, so names are the (mangled) names in the
+module. Counters are updated atomically by the JIT'd code, and can be read at any time. */
+struct ISlangLLVMJITCounters : public ISlangCastable
+{
+    SLANG_COM_INTERFACE(0x3d1c7a52, 0x8b0e, 0x4f61, { 0x9a, 0x27, 0xc4, 0x5e, 0x10, 0xb3, 0x6d, 0x84 })
+
+        /// The number of counted functions
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getFunctionCount() = 0;
+        /// Get the name of a function, index is from 0 to getFunctionCount() - 1. The same name can appear more than
+        /// once, if it's internal to multiple sources.
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getFunctionName(size_t index) = 0;
+        /// Get the counters of a function by index
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL getFunctionCounters(size_t index, SlangLLVMFunctionCounters* outCounters) = 0;
+        /// Get the counters of all functions with the name, summed. Returns SLANG_E_NOT_FOUND if there are none.
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL findFunctionCounters(const char* name, SlangLLVMFunctionCounters* outCounters) = 0;
+        /// Set all counters to 0
+    virtual SLANG_NO_THROW void SLANG_MCALL resetCounters() = 0;
+};
+
+/* The profile collected by a library compiled with -jit-pgo-generate. Obtained by using castAs on the library's
+ISlangSharedLibrary.
+
+Once the library has been run on representative data, harvestProfile adds the counts collected to the process wide
+profile of each source. Compiling the same sources with the same options, but -jit-pgo-use instead of
+-jit-pgo-generate, then optimizes using the profile. */
+struct ISlangLLVMJITProfile : public ISlangCastable
+{
+    SLANG_COM_INTERFACE(0xa4f2c9e1, 0x5d37, 0x4b8a, { 0x86, 0x0c, 0x2e, 0x91, 0x7f, 0x4d, 0xb5, 0x13 })
+
+        /// Add the counts collected since the last harvest to the profiles, and reset them. If a profile directory is
+        /// set, the profiles are also written to it - if that fails the in memory profiles are still updated.
+    virtual SLANG_NO_THROW SlangResult SLANG_MCALL harvestProfile() = 0;
+};
+
+/// The phases of a compilation that are timed
+typedef enum SlangLLVMCompilePhase
+{
+    SLANG_LLVM_COMPILE_PHASE_FRONTEND,          ///< Preprocessing, parsing and semantic analysis (which are interleaved), or parsing LLVM IR sources
+    SLANG_LLVM_COMPILE_PHASE_IRGEN,             ///< Generation of LLVM IR from the AST
+    SLANG_LLVM_COMPILE_PHASE_OPTIMIZE,          ///< The LLVM optimization pipeline
+    SLANG_LLVM_COMPILE_PHASE_CODEGEN,           ///< Code generation and linking by the JIT, or emitting object code
+    SLANG_LLVM_COMPILE_PHASE_TOTAL,             ///< The whole compilation
+    SLANG_LLVM_COMPILE_PHASE_COUNT_OF,
+} SlangLLVMCompilePhase;
+
+/// Time spent in a phase
+struct SlangLLVMPhaseTime
+{
+    double wallSeconds;
+    double cpuSeconds;              ///< CPU time of the threads of the compilation. Doesn't include the JIT's compile threads.
+};
+
+/// Sizes of the LLVM IR of a compilation
+struct SlangLLVMModuleCounts
+{
+    uint64_t functionCount;         ///< Function definitions
+    uint64_t basicBlockCount;
+    uint64_t instructionCount;
+};
+
+/* Metrics for a single compilation.
+
+The times of the phases other than SLANG_LLVM_COMPILE_PHASE_TOTAL are summed across translation units, so when units
+are compiled in parallel they can add up to more than the total wall time. */
+struct SlangLLVMCompileMetrics
+{
+    SlangLLVMPhaseTime phases[SLANG_LLVM_COMPILE_PHASE_COUNT_OF];   ///< Indexed by SlangLLVMCompilePhase
+
+    SlangLLVMModuleCounts beforeOptimization;   ///< The IR as produced by the frontend (or parsed)
+    SlangLLVMModuleCounts afterOptimization;
+
+    uint64_t translationUnitCount;
+    uint64_t objectCacheHitCount;   ///< Units loaded from the object cache. They skip all phases other than code generation, and aren't counted.
+    bool isCompileCacheHit;         ///< If set the artifact was linked from object code in the compile cache, and only the code generation and total times are set
+};
+
+/* The metrics of a compilation. The artifact returned by `compile` has an associated artifact (with
+ArtifactPayload::Metadata) which has this as a representation, so it can be found with castAs.
+
+LLVM statistics are only present if the compilation used `-llvm-stats`, and LLVM was built with statistics enabled. */
+struct ISlangLLVMCompileMetrics : public ISlangCastable
+{
+    SLANG_COM_INTERFACE(0x7b904ea6, 0xe694, 0x45c5, { 0xbe, 0x56, 0x73, 0xa5, 0x2f, 0x56, 0x49, 0xef })
+
+    virtual SLANG_NO_THROW const SlangLLVMCompileMetrics* SLANG_MCALL getMetrics() = 0;
+
+        /// The number of LLVM statistics (such as "NumInlined") that changed during the compilation
+    virtual SLANG_NO_THROW size_t SLANG_MCALL getStatisticCount() = 0;
+        /// Get the name of a statistic, index is from 0 to getStatisticCount() - 1. Names are sorted.
+    virtual SLANG_NO_THROW const char* SLANG_MCALL getStatisticName(size_t index) = 0;
+        /// Get the amount a statistic changed by during the compilation
+    virtual SLANG_NO_THROW uint64_t SLANG_MCALL getStatisticValue(size_t index) = 0;
+};
+
+/// Statistics for the in memory compile cache
+struct SlangLLVMCompileCacheStats
+{
+    uint64_t hitCount;              ///< Number of compiles that were satisfied from the cache
+    uint64_t missCount;             ///< Number of compiles that were not found in the cache
+    uint64_t evictionCount;         ///< Number of entries evicted to stay within the memory budget
+    uint64_t entryCount;            ///< Number of entries currently held
+    uint64_t usedBytes;             ///< The size of the object code held by entries
+    uint64_t budgetBytes;           ///< The memory budget. 0 means the cache is disabled.
+};
+
+/// Set the memory budget of the in memory compile cache. Setting 0 disables the cache and releases all entries.
+extern "C" SLANG_DLL_EXPORT void setLLVMCompileCacheMemoryBudget(size_t budgetInBytes);
+/// Get the current statistics of the in memory compile cache
+extern "C" SLANG_DLL_EXPORT void getLLVMCompileCacheStats(SlangLLVMCompileCacheStats* outStats);
+/// Release all entries held in the in memory compile cache. Does not reset the counters.
+extern "C" SLANG_DLL_EXPORT void clearLLVMCompileCache();
+
+typedef void(*SetLLVMCompileCacheMemoryBudgetFunc)(size_t budgetInBytes);
+typedef void(*GetLLVMCompileCacheStatsFunc)(SlangLLVMCompileCacheStats* outStats);
+typedef void(*ClearLLVMCompileCacheFunc)();
+
+/// Statistics for the on disk object cache
+struct SlangLLVMObjectCacheStats
+{
+    uint64_t hitCount;              ///< Number of compiles that loaded an object from the cache
+    uint64_t missCount;             ///< Number of compiles that did not find an object in the cache
+    uint64_t writeCount;            ///< Number of objects written to the cache
+    uint64_t writeFailureCount;     ///< Number of objects that could not be written (for example because of IO errors)
+    uint64_t bytesRead;             ///< Total size of objects loaded from the cache
+    uint64_t bytesWritten;          ///< Total size of objects written to the cache
+};
+
+/// Enable the on disk object cache, storing objects in the directory `path`, which will be created if necessary.
+/// maxSizeInBytes limits the size of the directory, with 0 meaning no limit other than that applied by default by LLVM.
+/// Passing nullptr as the path disables the cache.
+/// The directory can be safely shared between processes.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMObjectCacheDirectory(const char* path, uint64_t maxSizeInBytes);
+/// Get the current statistics of the on disk object cache
+extern "C" SLANG_DLL_EXPORT void getLLVMObjectCacheStats(SlangLLVMObjectCacheStats* outStats);
+
+typedef SlangResult(*SetLLVMObjectCacheDirectoryFunc)(const char* path, uint64_t maxSizeInBytes);
+typedef void(*GetLLVMObjectCacheStatsFunc)(SlangLLVMObjectCacheStats* outStats);
+
+/// Set the prelude for which a precompiled header (PCH) is used. Any compilation whose source starts with the
+/// prelude text will use a PCH built from the prelude, rather than parsing the prelude.
+/// If directory is set, PCHs are stored there and so can be reused across processes, otherwise PCHs are held
+/// in temporary files for the lifetime of the process. Passing nullptr as the prelude disables the feature.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMPreludePCH(const char* prelude, const char* directory);
+
+typedef SlangResult(*SetLLVMPreludePCHFunc)(const char* prelude, const char* directory);
+
+/// Make a function (or data) in the host process available to all JIT'd code, as the unmangled name.
+/// Fails if there is already a symbol with the name - including the functions slang-llvm provides.
+/// Compilations that have already completed are unaffected.
+extern "C" SLANG_DLL_EXPORT SlangResult addLLVMHostSymbol(const char* name, void* address);
+
+typedef SlangResult(*AddLLVMHostSymbolFunc)(const char* name, void* address);
+
+/// Set the number of threads the JIT uses for code generation. With 0 (the default) code is generated on the thread
+/// that requests it. With a thread pool, independent modules and lazily compiled functions are generated in parallel.
+/// A negative count uses a thread per hardware core.
+/// Must be called before the first compilation (or call to addLLVMHostSymbol) - otherwise fails.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMCompileThreadCount(int count);
+
+typedef SlangResult(*SetLLVMCompileThreadCountFunc)(int count);
+
+/// Set the CPU that code is generated for, instead of the host CPU. This is useful so the same code is produced
+/// across machines with different CPUs. features is a comma separated list of LLVM features to enable or disable
+/// (such as "+avx2,-avx512f"), and may be nullptr. Passing nullptr as the name reverts to the host CPU.
+/// Must be called before the first compilation - otherwise fails.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMTargetCPU(const char* name, const char* features);
+
+typedef SlangResult(*SetLLVMTargetCPUFunc)(const char* name, const char* features);
+
+/// Statistics for the pool that JIT'd code and data is allocated from
+struct SlangLLVMJITMemoryStats
+{
+    uint64_t slabCount;             ///< Number of slabs currently mapped
+    uint64_t reservedBytes;         ///< Total size of all slabs
+    uint64_t usedBytes;             ///< Bytes allocated from slabs. Allocations are in whole pages.
+    uint64_t requestedBytes;        ///< Bytes requested by the JIT. The difference from usedBytes is lost to page rounding.
+    uint64_t freeRangeCount;        ///< Number of separate free ranges across all slabs
+    uint64_t largestFreeRangeBytes; ///< Size of the largest free range
+    double fragmentation;           ///< 1 - largestFreeRangeBytes / free bytes. 0 means all free space is contiguous.
+};
+
+/// Configure the pool that JIT'd code and data is allocated from. Memory is carved out of slabs of slabSizeInBytes
+/// (larger if an object needs it), with code and data in separate slabs. A slab size of 0 disables the pool, such that
+/// the JIT maps memory for each object separately. If useHugePages is set, slabs are backed by transparent huge pages
+/// where available (Linux). The default is 16MB slabs without huge pages.
+/// Must be called before the first compilation - otherwise fails.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMJITMemoryPool(size_t slabSizeInBytes, bool useHugePages);
+/// Get the current statistics of the JIT memory pool
+extern "C" SLANG_DLL_EXPORT void getLLVMJITMemoryStats(SlangLLVMJITMemoryStats* outStats);
+
+typedef SlangResult(*SetLLVMJITMemoryPoolFunc)(size_t slabSizeInBytes, bool useHugePages);
+typedef void(*GetLLVMJITMemoryStatsFunc)(SlangLLVMJITMemoryStats* outStats);
+
+/// Set a directory that a time trace of every compilation is written to, as a file in Chrome's trace event format
+/// (as with clang's -ftime-trace). The directory is created if necessary. Passing nullptr stops traces being written.
+/// Compilations are traced one at a time, so a compilation that starts while another is being traced isn't traced
+/// (and has a warning), rather than waiting.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMTimeTraceDirectory(const char* path);
+
+typedef SlangResult(*SetLLVMTimeTraceDirectoryFunc)(const char* path);
+
+/// Tools that JIT'd code can be registered with, so they can find the code's functions and line tables
+typedef enum SlangLLVMJITEventListenerFlag
+{
+    SLANG_LLVM_JIT_EVENT_LISTENER_GDB = 0x1,        ///< GDB's JIT interface, which is also used by LLDB
+    SLANG_LLVM_JIT_EVENT_LISTENER_PERF_MAP = 0x2,   ///< Function names and addresses are appended to /tmp/perf-<pid>.map, for perf
+    SLANG_LLVM_JIT_EVENT_LISTENER_JITDUMP = 0x4,    ///< A jitdump file for `perf inject`, written to $JITDUMPDIR (or the current directory)
+} SlangLLVMJITEventListenerFlag;
+
+/// Register all JIT'd code with the tools in flags (a combination of SlangLLVMJITEventListenerFlag). When set,
+/// sources are compiled with line tables (following #line directives), so tools can map code back to the source.
+/// Code is unregistered when its artifact is released (perf maps can't express this).
+/// Must be called before the first compilation - otherwise fails. Returns SLANG_E_NOT_AVAILABLE if a tool isn't
+/// supported by the LLVM build or the target.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMJITEventListeners(uint32_t flags);
+
+typedef SlangResult(*SetLLVMJITEventListenersFunc)(uint32_t flags);
+
+/// Set a directory that profiles (see ISlangLLVMJITProfile) are written to when harvested, and read from when not in
+/// memory, so profiles persist between processes. The directory is created if necessary. Passing nullptr disables.
+/// Profiles harvested by different processes at the same time aren't merged, the last one written is kept.
+extern "C" SLANG_DLL_EXPORT SlangResult setLLVMProfileDirectory(const char* path);
+/// Release the in memory profiles. Profiles in the profile directory are kept.
+extern "C" SLANG_DLL_EXPORT void clearLLVMProfiles();
+
+typedef SlangResult(*SetLLVMProfileDirectoryFunc)(const char* path);
+typedef void(*ClearLLVMProfilesFunc)();
+
+/// Statistics for a batch compilation
+struct SlangLLVMBatchCompileStats
+{
+    uint64_t compileCount;          ///< Number of compilations in the batch
+    uint64_t failureCount;          ///< Number of compilations that failed (including those that failed with diagnostics)
+    double elapsedSeconds;          ///< Wall clock time for the whole batch
+    double compilesPerSecond;       ///< Throughput of the batch
+};
+
+/// Perform count independent compilations, spread across a pool of threadCount threads (0 uses a thread per core).
+/// The result of each compilation is written to outResults[i], and its artifact (which holds its diagnostics) to
+/// outArtifacts[i]. outResults and outStats are optional.
+/// Returns a failure only if the batch could not be run - the results of individual compilations are in outResults.
+extern "C" SLANG_DLL_EXPORT SlangResult compileLLVMBatch_V4(const Slang::DownstreamCompileOptions* options, size_t count, int threadCount, Slang::IArtifact** outArtifacts, SlangResult* outResults, SlangLLVMBatchCompileStats* outStats);
+
+typedef SlangResult(*CompileLLVMBatchFunc_V4)(const Slang::DownstreamCompileOptions* options, size_t count, int threadCount, Slang::IArtifact** outArtifacts, SlangResult* outResults, SlangLLVMBatchCompileStats* outStats);
+
+#endif